@@ -1,5 +1,7 @@
 #pragma once
 
+#include <functional>
+
 #include "llvm/IR/CFG.h"
 
 namespace pcpo {
@@ -56,9 +58,15 @@ public:
     // For all of the above, this operation returns whether the state changed as a result.
     // IMPORTANT: The simple fixpoint algorithm only performs UPPER_BOUND, so you do not need to
     // implement the others if you just use that one. (The more advanced algorithm in
-    // fixpoint_widening.cpp uses all three operations.)
+    // fixpoint_widening.h uses all three operations.)
     bool merge(Merge_op::Type op, AbstractStateDummy const& other) { return false; };
 
+    // Forget the values for which keep returns false. The engine calls this with the values that
+    // are still needed at the end of a block (see liveness.h) before it stores the state of the
+    // block, so that dead values do not take up space. Keeping everything is a valid
+    // implementation.
+    void project(std::function<bool(llvm::Value const*)> const& keep) {};
+
     // Restrict the set of values to the one that allows 'from' to branch towards
     // 'towards'. Starting with the state when exiting from, this should compute (an upper bound of)
     // the possible values that would reach the block towards. Doing nothing thus is a valid
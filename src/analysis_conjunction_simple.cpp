@@ -0,0 +1,22 @@
+// Linear equalities with the simple engine: the states are joined until they
+// are stable.
+
+#include "fixpoint_engine.h"
+#include "normalized_conjunction.h"
+#include "registry.h"
+
+namespace pcpo {
+
+template std::unordered_map<NodeKey, Node<NormalizedConjunction>>
+executeFixpointAlgorithm<NormalizedConjunction, 1000, Merge_op::UPPER_BOUND>(
+    llvm::Module const &M);
+
+namespace {
+
+AnalysisRegistration
+    registration{"conjunction", "simple",
+                 analyze_with<NormalizedConjunction, Merge_op::UPPER_BOUND>};
+
+} // namespace
+
+} // namespace pcpo
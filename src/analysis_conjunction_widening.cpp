@@ -0,0 +1,22 @@
+// Linear equalities with the widening engine: the states are widened at loops
+// and then narrowed.
+
+#include "fixpoint_engine.h"
+#include "normalized_conjunction.h"
+#include "registry.h"
+
+namespace pcpo {
+
+template std::unordered_map<NodeKey, Node<NormalizedConjunction>>
+executeFixpointAlgorithm<NormalizedConjunction, 1000, Merge_op::WIDEN>(
+    llvm::Module const &M);
+
+namespace {
+
+AnalysisRegistration
+    registration{"conjunction", "widening",
+                 analyze_with<NormalizedConjunction, Merge_op::WIDEN>};
+
+} // namespace
+
+} // namespace pcpo
@@ -0,0 +1,25 @@
+// Constant folding with the simple engine: the states are joined until they
+// are stable.
+
+#include "constant_folding.h"
+#include "fixpoint_engine.h"
+#include "integer_domain.h"
+#include "registry.h"
+
+namespace pcpo {
+
+using Constants = ConstantFolding<IntegerDomain>;
+
+template std::unordered_map<NodeKey, Node<Constants>>
+executeFixpointAlgorithm<Constants, 1000, Merge_op::UPPER_BOUND>(
+    llvm::Module const &M);
+
+namespace {
+
+AnalysisRegistration
+    registration{"constant", "simple",
+                 analyze_with<Constants, Merge_op::UPPER_BOUND>};
+
+} // namespace
+
+} // namespace pcpo
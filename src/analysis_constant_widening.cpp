@@ -0,0 +1,24 @@
+// Constant folding with the widening engine: the states are widened at loops
+// and then narrowed.
+
+#include "constant_folding.h"
+#include "fixpoint_engine.h"
+#include "integer_domain.h"
+#include "registry.h"
+
+namespace pcpo {
+
+using Constants = ConstantFolding<IntegerDomain>;
+
+template std::unordered_map<NodeKey, Node<Constants>>
+executeFixpointAlgorithm<Constants, 1000, Merge_op::WIDEN>(
+    llvm::Module const &M);
+
+namespace {
+
+AnalysisRegistration registration{"constant", "widening",
+                                  analyze_with<Constants, Merge_op::WIDEN>};
+
+} // namespace
+
+} // namespace pcpo
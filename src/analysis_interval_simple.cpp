@@ -0,0 +1,25 @@
+// Intervals with the simple engine: the states are joined until they
+// are stable.
+
+#include "fixpoint_engine.h"
+#include "registry.h"
+#include "simple_interval.h"
+#include "value_set.h"
+
+namespace pcpo {
+
+using Intervals = AbstractStateValueSet<SimpleInterval>;
+
+template std::unordered_map<NodeKey, Node<Intervals>>
+executeFixpointAlgorithm<Intervals, 1000, Merge_op::UPPER_BOUND>(
+    llvm::Module const &M);
+
+namespace {
+
+AnalysisRegistration
+    registration{"interval", "simple",
+                 analyze_with<Intervals, Merge_op::UPPER_BOUND>};
+
+} // namespace
+
+} // namespace pcpo
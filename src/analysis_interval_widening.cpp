@@ -0,0 +1,24 @@
+// Intervals with the widening engine: the states are widened at loops
+// and then narrowed.
+
+#include "fixpoint_engine.h"
+#include "registry.h"
+#include "simple_interval.h"
+#include "value_set.h"
+
+namespace pcpo {
+
+using Intervals = AbstractStateValueSet<SimpleInterval>;
+
+template std::unordered_map<NodeKey, Node<Intervals>>
+executeFixpointAlgorithm<Intervals, 1000, Merge_op::WIDEN>(
+    llvm::Module const &M);
+
+namespace {
+
+AnalysisRegistration registration{"interval", "widening",
+                                  analyze_with<Intervals, Merge_op::WIDEN>};
+
+} // namespace
+
+} // namespace pcpo
@@ -0,0 +1,22 @@
+// Affine relations with the simple engine: the states are joined until they
+// are stable.
+
+#include "fixpoint_engine.h"
+#include "linear_subspace.h"
+#include "registry.h"
+
+namespace pcpo {
+
+template std::unordered_map<NodeKey, Node<LinearSubspace>>
+executeFixpointAlgorithm<LinearSubspace, 1000, Merge_op::UPPER_BOUND>(
+    llvm::Module const &M);
+
+namespace {
+
+AnalysisRegistration
+    registration{"subspace", "simple",
+                 analyze_with<LinearSubspace, Merge_op::UPPER_BOUND>};
+
+} // namespace
+
+} // namespace pcpo
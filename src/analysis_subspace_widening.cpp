@@ -0,0 +1,22 @@
+// Affine relations with the widening engine: the states are widened at loops
+// and then narrowed.
+
+#include "fixpoint_engine.h"
+#include "linear_subspace.h"
+#include "registry.h"
+
+namespace pcpo {
+
+template std::unordered_map<NodeKey, Node<LinearSubspace>>
+executeFixpointAlgorithm<LinearSubspace, 1000, Merge_op::WIDEN>(
+    llvm::Module const &M);
+
+namespace {
+
+AnalysisRegistration
+    registration{"subspace", "widening",
+                 analyze_with<LinearSubspace, Merge_op::WIDEN>};
+
+} // namespace
+
+} // namespace pcpo
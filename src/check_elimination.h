@@ -0,0 +1,207 @@
+#pragma once
+
+#include <unordered_set>
+#include <vector>
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/InstrTypes.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/PatternMatch.h>
+#include <llvm/IR/ValueHandle.h>
+#include <llvm/Transforms/Utils/Local.h>
+
+#include "global.h"
+#include "range_annotation.h"
+#include "simple_interval.h"
+#include "value_set.h"
+
+namespace pcpo {
+
+/// Interval analysis whose results are used to remove the checks inserted by
+/// -fsanitize=signed-integer-overflow,bounds (and the unsigned variant). A
+/// check is a conditional branch to a block calling a UBSan handler. It is
+/// discharged if the branch towards the handler is infeasible: either the
+/// condition is the overflow bit of an arithmetic intrinsic whose operands
+/// cannot overflow, or refining the state with the condition yields bottom,
+/// as for index comparisons. The number of discharged checks of each function
+/// is reported.
+class CheckElimination : public AbstractStateValueSet<SimpleInterval> {
+public:
+  using AbstractStateValueSet<SimpleInterval>::AbstractStateValueSet;
+
+  void applyPHINode(llvm::BasicBlock const &bb,
+                    std::vector<CheckElimination> const &pred_values,
+                    llvm::Instruction const &inst) {
+    std::vector<AbstractStateValueSet<SimpleInterval>> preds(
+        pred_values.begin(), pred_values.end());
+    AbstractStateValueSet<SimpleInterval>::applyPHINode(bb, preds, inst);
+  }
+
+  /// Removes the checks of function that cannot fire, where state_of(bb) is
+  /// the outgoing state of bb, joined over all contexts. Handler blocks that
+  /// are no longer reached are deleted, and arithmetic intrinsics that cannot
+  /// overflow become nsw or nuw instructions. Returns whether the function
+  /// changed.
+  template <typename StateOf>
+  static bool transformFunction(llvm::Function &function,
+                                StateOf const &state_of) {
+    std::unordered_set<llvm::WithOverflowInst *> proven;
+    for (llvm::BasicBlock &bb : function) {
+      CheckElimination const &state = state_of(&bb);
+      if (state.isBottom)
+        continue;
+      for (llvm::Instruction &inst : bb) {
+        auto intrinsic = dyn_cast<llvm::WithOverflowInst>(&inst);
+        if (intrinsic && state.cannotOverflow(*intrinsic)) {
+          proven.insert(intrinsic);
+        }
+      }
+    }
+
+    // Branches whose handler is never reached, and the successor they take
+    std::vector<std::pair<llvm::BranchInst *, llvm::BasicBlock *>> discharged;
+    unsigned checks = 0;
+    for (llvm::BasicBlock &bb : function) {
+      auto branch = dyn_cast<llvm::BranchInst>(bb.getTerminator());
+      if (!branch || branch->isUnconditional() ||
+          branch->getSuccessor(0) == branch->getSuccessor(1))
+        continue;
+      int handler = isHandler(*branch->getSuccessor(0))   ? 0
+                    : isHandler(*branch->getSuccessor(1)) ? 1
+                                                          : -1;
+      CheckElimination const &state = state_of(&bb);
+      if (handler < 0 || state.isBottom)
+        continue;
+
+      ++checks;
+      if (state.isInfeasible(*branch, handler, proven)) {
+        discharged.push_back({branch, branch->getSuccessor(1 - handler)});
+      }
+    }
+
+    // The overflow bits become false, which does not change the conditions
+    for (llvm::WithOverflowInst *intrinsic : proven) {
+      replaceIntrinsic(*intrinsic);
+    }
+
+    for (auto [branch, taken] : discharged) {
+      llvm::BasicBlock *bb = branch->getParent();
+      for (llvm::BasicBlock *succ : llvm::successors(bb)) {
+        if (succ != taken) {
+          succ->removePredecessor(bb);
+        }
+      }
+      llvm::Value *condition = branch->getCondition();
+      llvm::BranchInst::Create(taken, branch);
+      branch->eraseFromParent();
+      llvm::RecursivelyDeleteTriviallyDeadInstructions(condition);
+    }
+
+    if (checks > 0) {
+      report() << function.getName() << ": " << discharged.size() << " of "
+               << checks << " sanitizer checks discharged\n";
+    }
+    if (!discharged.empty()) {
+      llvm::removeUnreachableBlocks(function);
+    }
+    return !discharged.empty() || !proven.empty();
+  }
+
+private:
+  /// Whether bb reports a failed check
+  static bool isHandler(llvm::BasicBlock const &bb) {
+    for (llvm::Instruction const &inst : bb) {
+      auto call = dyn_cast<llvm::CallInst>(&inst);
+      llvm::Function const *callee = call ? call->getCalledFunction() : nullptr;
+      if (callee && (callee->getName().startswith("__ubsan_handle_") ||
+                     callee->getName() == "llvm.ubsantrap"))
+        return true;
+    }
+    return false;
+  }
+
+  bool cannotOverflow(llvm::WithOverflowInst const &intrinsic) const {
+    SimpleInterval a = getAbstractValue(*intrinsic.getLHS());
+    SimpleInterval b = getAbstractValue(*intrinsic.getRHS());
+    if (a.state != SimpleInterval::NORMAL || b.state != SimpleInterval::NORMAL)
+      return false;
+
+    unsigned opcode = intrinsic.getBinaryOp();
+    return intrinsic.isSigned() ? RangeAnnotation::noSignedWrap(opcode, a, b)
+                                : RangeAnnotation::noUnsignedWrap(opcode, a, b);
+  }
+
+  /// Whether the successor handler of branch is never taken
+  bool isInfeasible(
+      llvm::BranchInst const &branch, int handler,
+      std::unordered_set<llvm::WithOverflowInst *> const &proven) const {
+    using namespace llvm::PatternMatch;
+
+    // The overflow bit of a proven intrinsic is false
+    llvm::Value *condition = branch.getCondition();
+    llvm::Value *bit = condition;
+    bool negated = match(condition, m_Not(m_Value(bit)));
+    auto extract = dyn_cast<llvm::ExtractValueInst>(bit);
+    if (extract && extract->getNumIndices() == 1 &&
+        *extract->idx_begin() == 1) {
+      auto intrinsic =
+          dyn_cast<llvm::WithOverflowInst>(extract->getAggregateOperand());
+      if (intrinsic && proven.count(intrinsic)) {
+        // The true successor is taken if negated
+        return negated == (handler == 1);
+      }
+    }
+
+    AbstractStateValueSet<SimpleInterval> towards{*this};
+    towards.branch(*branch.getParent(), *branch.getSuccessor(handler));
+    return towards.isBottom;
+  }
+
+  /// Replaces the results of intrinsic, which cannot overflow, by a plain
+  /// instruction and false
+  static void replaceIntrinsic(llvm::WithOverflowInst &intrinsic) {
+    llvm::BinaryOperator *op = llvm::BinaryOperator::Create(
+        intrinsic.getBinaryOp(), intrinsic.getLHS(), intrinsic.getRHS(), "",
+        &intrinsic);
+    if (intrinsic.isSigned()) {
+      op->setHasNoSignedWrap(true);
+    } else {
+      op->setHasNoUnsignedWrap(true);
+    }
+
+    // Users of the bits, which may become dead
+    std::vector<llvm::WeakTrackingVH> users;
+    for (llvm::User *user :
+         llvm::make_early_inc_range(intrinsic.users())) {
+      auto extract = dyn_cast<llvm::ExtractValueInst>(user);
+      if (!extract || extract->getNumIndices() != 1)
+        continue;
+      if (*extract->idx_begin() == 0) {
+        op->takeName(extract);
+        extract->replaceAllUsesWith(op);
+      } else {
+        for (llvm::User *bit_user : extract->users()) {
+          users.push_back(bit_user);
+        }
+        extract->replaceAllUsesWith(
+            llvm::ConstantInt::getFalse(intrinsic.getContext()));
+      }
+      extract->eraseFromParent();
+    }
+
+    if (intrinsic.use_empty()) {
+      intrinsic.eraseFromParent();
+    }
+    if (op->use_empty()) {
+      op->eraseFromParent();
+    }
+    for (llvm::WeakTrackingVH const &user : users) {
+      if (user) {
+        llvm::RecursivelyDeleteTriviallyDeadInstructions(user);
+      }
+    }
+  }
+};
+
+} // namespace pcpo
@@ -6,6 +6,8 @@
 #include <unordered_set>
 
 #include <llvm/IR/Instructions.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/Local.h>
 
 #include "global.h"
 #include "value_set.h"
@@ -30,45 +32,105 @@ public:
     AbstractStateValueSet<T>::applyPHINode(bb, preds, inst);
   }
 
-  bool transformPHINode(llvm::BasicBlock const &bb,
-                        std::vector<ConstantFolding> const &pred_values,
-                        llvm::Instruction &inst) {
-
-    llvm::PHINode *phiNode = dyn_cast<llvm::PHINode>(&inst);
-    bool hasChanged = false;
-
-    int i = 0;
-    for (llvm::BasicBlock const *predBB : llvm::predecessors(&bb)) {
-      auto &incomingValue = *phiNode->getIncomingValueForBlock(predBB);
-      auto &incomingState = pred_values[i];
-
-      if (values.count(&incomingValue)) {
-        auto x = values.at(&incomingValue).toConstant(incomingValue.getType());
+  /// Constant that value has in this state, if there is one.
+  std::optional<llvm::Constant *> constantOf(llvm::Value const &value) const {
+    auto it = values.find(&value);
+    if (it == values.end() || !value.getType()->isIntegerTy())
+      return std::nullopt;
+    return it->second.toConstant(value.getType());
+  }
 
-        if (x.has_value()) {
-          phiNode->setIncomingValueForBlock(predBB, x.value());
-          hasChanged = true;
+  /// Rewrites function like sparse conditional constant propagation, where
+  /// state_of(bb) is the outgoing state of bb, joined over all contexts. The
+  /// function must have been analyzed, i.e. its entry block was reached.
+  ///  - Instructions with a constant value are replaced by it, and erased if
+  ///    they have no side effects.
+  ///  - Branches and switches on constant conditions become unconditional.
+  ///  - Blocks that are never reached are deleted, and blocks that are reached
+  ///    but never left end in unreachable.
+  ///  - Phis whose incoming values are all the same are replaced by it.
+  /// Returns whether the function changed.
+  template <typename StateOf>
+  static bool transformFunction(llvm::Function &function,
+                                StateOf const &state_of) {
+    // Everything is decided before changing the IR, as the states refer to the
+    // values that are erased.
+    std::unordered_set<llvm::BasicBlock *> reachable;
+    std::vector<llvm::BasicBlock *> stuck;
+    std::vector<std::pair<llvm::Instruction *, llvm::Constant *>> constants;
+
+    std::vector<llvm::BasicBlock *> stack = {&function.getEntryBlock()};
+    reachable.insert(&function.getEntryBlock());
+    while (!stack.empty()) {
+      llvm::BasicBlock *bb = stack.back();
+      stack.pop_back();
+
+      ConstantFolding const &state = state_of(bb);
+      if (state.isBottom) {
+        stuck.push_back(bb);
+        continue;
+      }
+      for (llvm::Instruction &inst : *bb) {
+        if (auto constant = state.constantOf(inst)) {
+          constants.push_back({&inst, constant.value()});
+        }
+      }
+      for (llvm::BasicBlock *succ : llvm::successors(bb)) {
+        if (reachable.insert(succ).second) {
+          stack.push_back(succ);
         }
       }
-
-      i++;
     }
 
-    return hasChanged;
-  }
-
-  bool transformDefault(llvm::Instruction &inst) {
-    bool hasChanged = false;
+    std::vector<llvm::BasicBlock *> unreachable;
+    for (llvm::BasicBlock &bb : function) {
+      if (!reachable.count(&bb)) {
+        unreachable.push_back(&bb);
+      }
+    }
 
-    for (int i = 0; i < inst.getNumOperands(); i++) {
-      auto operand = inst.getOperand(i);
+    bool hasChanged = !stuck.empty() || !unreachable.empty();
 
-      if (values.count(operand)) {
-        auto opConstant = values.at(operand).toConstant(operand->getType());
+    for (llvm::BasicBlock *bb : stuck) {
+      llvm::Instruction *terminator = bb->getTerminator();
+      // Phis are simplified below, the constants may still refer to them
+      for (llvm::BasicBlock *succ : llvm::successors(bb)) {
+        succ->removePredecessor(bb, true);
+      }
+      new llvm::UnreachableInst(function.getContext(), terminator);
+      terminator->eraseFromParent();
+    }
+    // Only unreachable blocks lead into unreachable blocks now. One-input
+    // phis are kept for the same reason as above.
+    llvm::DeleteDeadBlocks(unreachable, nullptr, /*KeepOneInputPHIs=*/true);
+
+    for (auto [inst, constant] : constants) {
+      if (!inst->use_empty()) {
+        inst->replaceAllUsesWith(constant);
+        hasChanged = true;
+      }
+      if (llvm::isInstructionTriviallyDead(inst)) {
+        inst->eraseFromParent();
+        hasChanged = true;
+      }
+    }
 
-        if (opConstant.has_value()) {
-          inst.setOperand(i, opConstant.value());
-          hasChanged = true;
+    // Removing edges simplifies phis, which may decide more conditions
+    for (bool changed = true; changed; hasChanged |= changed) {
+      changed = false;
+      for (llvm::BasicBlock &bb : function) {
+        changed |= llvm::ConstantFoldTerminator(&bb, true);
+      }
+      changed |= llvm::removeUnreachableBlocks(function);
+
+      for (llvm::BasicBlock &bb : function) {
+        for (llvm::PHINode &phi : llvm::make_early_inc_range(bb.phis())) {
+          llvm::Value *value = phi.hasConstantValue();
+          if (value && value != &phi) {
+            phi.replaceAllUsesWith(value);
+            phi.eraseFromParent();
+            changed = true;
+          }
         }
       }
     }
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include <llvm/ADT/DepthFirstIterator.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/Function.h>
+
+namespace pcpo {
+
+/// AbstractState::Delta, or NoDelta if the state cannot be stored as a delta.
+/// A delta d of a state s against a base b is made by s.deltaFrom(b), and
+/// applyDelta(d) on a copy of b gives back s.
+struct NoDelta {};
+template <typename AbstractState, typename = void> struct DeltaOf {
+  using type = NoDelta;
+};
+template <typename AbstractState>
+struct DeltaOf<AbstractState, std::void_t<typename AbstractState::Delta>> {
+  using type = typename AbstractState::Delta;
+};
+
+/// Whether AbstractState can be stored in DeltaStates
+template <typename AbstractState>
+constexpr bool has_delta =
+    !std::is_same_v<typename DeltaOf<AbstractState>::type, NoDelta>;
+
+/// States of basic blocks, where most blocks only store the values in which
+/// their state differs from the state of their immediate dominator. Those
+/// tend to be few, as a block mostly passes on the values it does not
+/// define. The entry blocks, and blocks whose chain of deltas gets too long,
+/// store a full snapshot instead. Loop heads and join points, where the
+/// states differ the most from their dominator, take one after a shorter
+/// chain.
+///
+/// A state is resolved by applying the deltas to the nearest snapshot. The
+/// resolved states of the function read last are cached, so reading the
+/// states of a function block by block only applies each delta once.
+template <typename AbstractState> class DeltaStates {
+public:
+  /// Moves the states of the blocks of function out of states
+  void add(llvm::Function const &function,
+           std::unordered_map<llvm::BasicBlock const *, AbstractState>
+               &states) {
+    // Only reads the function
+    llvm::DominatorTree dominators{const_cast<llvm::Function &>(function)};
+    std::unordered_map<llvm::BasicBlock const *, int> chain_length;
+
+    // Dominators come first, so every base is stored before its dependents.
+    // A block that is reached has a reached immediate dominator.
+    for (llvm::DomTreeNode *dom_node :
+         llvm::depth_first(dominators.getRootNode())) {
+      llvm::BasicBlock const *basic_block = dom_node->getBlock();
+      auto it = states.find(basic_block);
+      if (it == states.end()) {
+        continue;
+      }
+
+      Entry entry{&function};
+      llvm::DomTreeNode *idom = dom_node->getIDom();
+      llvm::BasicBlock const *base = idom ? idom->getBlock() : nullptr;
+      int length = base && entries.count(base) ? chain_length[base] + 1 : 0;
+      if (length > 0 && !needsSnapshot(*basic_block, length, dominators)) {
+        Entry const &base_entry = entries.at(base);
+        entry.base = base;
+        entry.delta = it->second.deltaFrom(
+            base_entry.base ? states.at(base) : base_entry.snapshot);
+        ++deltas;
+      } else {
+        length = 0;
+        entry.snapshot = std::move(it->second);
+        ++snapshots;
+      }
+      chain_length[basic_block] = length;
+      entries.emplace(basic_block, std::move(entry));
+    }
+
+    for (llvm::BasicBlock const &basic_block : function) {
+      states.erase(&basic_block);
+    }
+  }
+
+  bool contains(llvm::BasicBlock const *basic_block) const {
+    return entries.count(basic_block) != 0;
+  }
+
+  /// State of basic_block, which has to be contained
+  AbstractState get(llvm::BasicBlock const *basic_block) const {
+    return resolve(basic_block);
+  }
+
+  /// Number of blocks stored as a snapshot and as a delta
+  size_t snapshotCount() const { return snapshots; }
+  size_t deltaCount() const { return deltas; }
+
+private:
+  /// Longest chain of deltas. Loop heads and join points end it once it is
+  /// half as long.
+  static constexpr int max_chain = 8;
+
+  struct Entry {
+    llvm::Function const *function;
+    /// Immediate dominator, or nullptr for a snapshot
+    llvm::BasicBlock const *base = nullptr;
+    AbstractState snapshot = {};
+    typename DeltaOf<AbstractState>::type delta = {};
+  };
+
+  /// State of basic_block, only valid until a block of another function is
+  /// resolved
+  AbstractState const &resolve(llvm::BasicBlock const *basic_block) const {
+    Entry const &entry = entries.at(basic_block);
+    if (!entry.base) {
+      return entry.snapshot;
+    }
+
+    if (entry.function != cached_function) {
+      cache.clear();
+      cached_function = entry.function;
+    }
+    auto it = cache.find(basic_block);
+    if (it != cache.end()) {
+      return it->second;
+    }
+
+    AbstractState state = resolve(entry.base);
+    state.applyDelta(entry.delta);
+    return cache.emplace(basic_block, std::move(state)).first->second;
+  }
+
+  static bool needsSnapshot(llvm::BasicBlock const &basic_block, int length,
+                            llvm::DominatorTree const &dominators) {
+    if (length > max_chain) {
+      return true;
+    }
+    bool is_join = llvm::pred_size(&basic_block) > 1;
+    bool is_loop_head = false;
+    for (llvm::BasicBlock const *pred : llvm::predecessors(&basic_block)) {
+      is_loop_head |= dominators.dominates(&basic_block, pred);
+    }
+    return (is_join || is_loop_head) && length > max_chain / 2;
+  }
+
+  std::unordered_map<llvm::BasicBlock const *, Entry> entries;
+  size_t snapshots = 0;
+  size_t deltas = 0;
+
+  mutable llvm::Function const *cached_function = nullptr;
+  mutable std::unordered_map<llvm::BasicBlock const *, AbstractState> cache;
+};
+
+} // namespace pcpo
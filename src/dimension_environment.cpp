@@ -0,0 +1,82 @@
+#include "dimension_environment.h"
+
+using namespace llvm;
+
+namespace pcpo {
+
+DimensionEnvironment::DimensionEnvironment(std::vector<Value const*> variables): variables{std::move(variables)} {
+    index.reserve(this->variables.size());
+    for (int i = 0; i < int(this->variables.size()); i++) {
+        index[this->variables[i]] = i + 1;
+    }
+    assert(index.size() == this->variables.size() && "variables have to be unique");
+}
+
+DimensionEnvironment::Ptr DimensionEnvironment::empty() {
+    static Ptr const empty = std::make_shared<DimensionEnvironment const>();
+    return empty;
+}
+
+DimensionEnvironment::Ptr DimensionEnvironment::make(std::vector<Value const*> const& variables) {
+    if (variables.empty()) return empty();
+    return std::make_shared<DimensionEnvironment const>(variables);
+}
+
+DimensionEnvironment::Ptr DimensionEnvironment::extend(Ptr const& env, Value const* variable) {
+    if (env->contains(variable)) return env;
+
+    std::lock_guard<std::mutex> lock(env->extensions_mutex);
+    if (Ptr cached = env->extensions[variable].lock()) {
+        return cached;
+    }
+    std::vector<Value const*> variables = env->variables;
+    variables.push_back(variable);
+    Ptr result = std::make_shared<DimensionEnvironment const>(std::move(variables));
+    for (auto it = env->extensions.begin(); it != env->extensions.end();) {
+        it = it->second.expired() ? env->extensions.erase(it) : std::next(it);
+    }
+    env->extensions[variable] = result;
+    return result;
+}
+
+DimensionEnvironment::Ptr DimensionEnvironment::extend(Ptr const& env, std::vector<Value const*> const& variables) {
+    std::vector<Value const*> missing;
+    for (Value const* variable: variables) {
+        if (!env->contains(variable)) missing.push_back(variable);
+    }
+
+    if (missing.empty()) return env;
+    if (missing.size() == 1) return extend(env, missing.front());
+
+    std::vector<Value const*> result = env->variables;
+    result.insert(result.end(), missing.begin(), missing.end());
+    return make(result);
+}
+
+DimensionEnvironment::Ptr DimensionEnvironment::project(Ptr const& env, std::function<bool(Value const*)> const& keep) {
+    std::vector<Value const*> result;
+    result.reserve(env->variables.size());
+    for (Value const* variable: env->variables) {
+        if (keep(variable)) result.push_back(variable);
+    }
+
+    if (result.size() == env->variables.size()) return env;
+    return make(result);
+}
+
+DimensionEnvironment::Ptr DimensionEnvironment::join(Ptr const& a, Ptr const& b) {
+    if (a == b || a->includes(*b)) return a;
+    if (b->includes(*a)) return b;
+    return extend(a, b->variables);
+}
+
+bool DimensionEnvironment::includes(DimensionEnvironment const& other) const {
+    if (this == &other) return true;
+    if (other.size() > size()) return false;
+    for (Value const* variable: other.variables) {
+        if (!contains(variable)) return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <llvm/IR/Value.h>
+
+namespace pcpo {
+
+/// Maps llvm values to the dimensions of a relational state. Environments are immutable and shared
+/// between all states over the same set of variables, so that copying a state only copies a pointer
+/// and the numeric payload. Dimensions are numbered starting at 1, as dimension 0 is used for the
+/// constant column of `LinearSubspace`.
+///
+/// New environments are only created by `extend`, `project` and `join`. Extending by a single
+/// variable is memoised per environment, so states that assign the same variables along a path end
+/// up with the same environment pointer, and comparing environments is usually a pointer compare.
+class DimensionEnvironment {
+public:
+    using Ptr = std::shared_ptr<DimensionEnvironment const>;
+
+    DimensionEnvironment() = default;
+    explicit DimensionEnvironment(std::vector<llvm::Value const*> variables);
+
+    /// The shared environment without any variables.
+    static Ptr empty();
+    /// Creates an environment where `variables[i]` has dimension `i + 1`.
+    static Ptr make(std::vector<llvm::Value const*> const& variables);
+
+    /// Environment that additionally contains `variable`. Existing dimensions are kept, new ones
+    /// are appended. Returns `env` itself, if the variable is already part of it.
+    static Ptr extend(Ptr const& env, llvm::Value const* variable);
+    static Ptr extend(Ptr const& env, std::vector<llvm::Value const*> const& variables);
+    /// Environment that only contains the variables for which `keep` returns true. The remaining
+    /// dimensions are compacted, but keep their relative order.
+    static Ptr project(Ptr const& env, std::function<bool(llvm::Value const*)> const& keep);
+    /// Smallest environment containing the variables of both `a` and `b`. If one of them includes
+    /// the other, it is returned as is, otherwise the variables of `b` are appended to `a`.
+    static Ptr join(Ptr const& a, Ptr const& b);
+
+    int size() const { return int(variables.size()); };
+    bool contains(llvm::Value const* variable) const { return index.count(variable) != 0; };
+    /// Dimension of `variable`, which has to be part of the environment.
+    int dimension(llvm::Value const* variable) const { return index.at(variable); };
+    /// Variable of the dimension `dim`, with 1 <= dim <= size().
+    llvm::Value const* variable(int dim) const { return variables[dim - 1]; };
+    /// All variables, ordered by their dimension.
+    std::vector<llvm::Value const*> const& getVariables() const { return variables; };
+
+    /// Whether every variable of `other` is part of this environment.
+    bool includes(DimensionEnvironment const& other) const;
+    bool operator==(DimensionEnvironment const& other) const { return variables == other.variables; };
+    bool operator!=(DimensionEnvironment const& other) const { return !(*this == other); };
+
+private:
+    std::vector<llvm::Value const*> variables;
+    std::unordered_map<llvm::Value const*, int> index;
+
+    // Memoised single variable extensions. Weak, so that unused environments are still freed.
+    // Expired entries are erased whenever a new extension is stored, so that the map does not keep
+    // growing with every extension that was discarded.
+    mutable std::mutex extensions_mutex;
+    mutable std::unordered_map<llvm::Value const*, std::weak_ptr<DimensionEnvironment const>> extensions;
+};
+
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <vector>
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/InstrTypes.h>
+#include <llvm/IR/Instructions.h>
+
+#include "global.h"
+#include "simple_interval.h"
+#include "value_set.h"
+
+namespace pcpo {
+
+/// Interval analysis whose results are used to replace divisions and
+/// remainders by cheaper instructions:
+///  - Signed operations on non-negative operands become unsigned ones.
+///  - Division and remainder by a power of two become lshr and and.
+///  - x urem y becomes x if x < y, or a conditional subtraction if x < 2y.
+///  - x udiv y becomes 0 if x < y.
+class DivisionReduction : public AbstractStateValueSet<SimpleInterval> {
+public:
+  using AbstractStateValueSet<SimpleInterval>::AbstractStateValueSet;
+
+  void applyPHINode(llvm::BasicBlock const &bb,
+                    std::vector<DivisionReduction> const &pred_values,
+                    llvm::Instruction const &inst) {
+    std::vector<AbstractStateValueSet<SimpleInterval>> preds(
+        pred_values.begin(), pred_values.end());
+    AbstractStateValueSet<SimpleInterval>::applyPHINode(bb, preds, inst);
+  }
+
+  /// Rewrites the divisions of function, where state_of(bb) is the outgoing
+  /// state of bb, joined over all contexts. Returns whether the function
+  /// changed.
+  template <typename StateOf>
+  static bool transformFunction(llvm::Function &function,
+                                StateOf const &state_of) {
+    bool hasChanged = false;
+
+    for (llvm::BasicBlock &bb : function) {
+      DivisionReduction const &state = state_of(&bb);
+      if (state.isBottom)
+        continue;
+
+      std::vector<llvm::BinaryOperator *> divisions;
+      for (llvm::Instruction &inst : bb) {
+        auto op = dyn_cast<llvm::BinaryOperator>(&inst);
+        if (op && op->getType()->isIntegerTy() && isDivision(*op)) {
+          divisions.push_back(op);
+        }
+      }
+
+      for (llvm::BinaryOperator *op : divisions) {
+        llvm::Value *replacement = state.reduce(*op);
+        if (!replacement)
+          continue;
+        dbgs(3) << "  Reduced" << *op << " to" << *replacement << '\n';
+        if (replacement != op->getOperand(0)) {
+          replacement->takeName(op);
+        }
+        op->replaceAllUsesWith(replacement);
+        op->eraseFromParent();
+        hasChanged = true;
+      }
+    }
+
+    return hasChanged;
+  }
+
+private:
+  static bool isDivision(llvm::BinaryOperator const &op) {
+    switch (op.getOpcode()) {
+    case llvm::Instruction::UDiv:
+    case llvm::Instruction::SDiv:
+    case llvm::Instruction::URem:
+    case llvm::Instruction::SRem:
+      return true;
+    }
+    return false;
+  }
+
+  static bool isNonNegative(SimpleInterval const &interval) {
+    return interval.state == SimpleInterval::NORMAL &&
+           interval._smin().isNonNegative();
+  }
+
+  /// The cheaper replacement of op, inserted before it, or nullptr if there
+  /// is none
+  llvm::Value *reduce(llvm::BinaryOperator &op) const {
+    llvm::Value *x = op.getOperand(0);
+    llvm::Value *y = op.getOperand(1);
+    SimpleInterval a = getAbstractValue(*x);
+    SimpleInterval b = getAbstractValue(*y);
+    if (a.state != SimpleInterval::NORMAL || b.state != SimpleInterval::NORMAL)
+      return nullptr;
+
+    unsigned opcode = op.getOpcode();
+    bool is_signed = opcode == llvm::Instruction::SDiv ||
+                     opcode == llvm::Instruction::SRem;
+    if (is_signed) {
+      if (!isNonNegative(a) || !isNonNegative(b))
+        return nullptr;
+      opcode = opcode == llvm::Instruction::SDiv ? llvm::Instruction::UDiv
+                                                 : llvm::Instruction::URem;
+    }
+
+    llvm::IRBuilder<> builder{&op};
+    llvm::Type *type = op.getType();
+
+    // A singleton divisor that is a power of two
+    if (b.begin == b.end && b.begin.isPowerOf2()) {
+      if (opcode == llvm::Instruction::UDiv) {
+        return builder.CreateLShr(x, b.begin.logBase2());
+      }
+      return builder.CreateAnd(x, llvm::ConstantInt::get(type, b.begin - 1));
+    }
+
+    llvm::APInt x_max = a._umax();
+    llvm::APInt y_min = b._umin();
+    if (x_max.ult(y_min)) {
+      if (opcode == llvm::Instruction::UDiv) {
+        return llvm::ConstantInt::get(type, 0);
+      }
+      return x;
+    }
+
+    bool overflow = false;
+    llvm::APInt twice_y_min = y_min.umul_ov(llvm::APInt(y_min.getBitWidth(), 2),
+                                            overflow);
+    if (opcode == llvm::Instruction::URem &&
+        (overflow || x_max.ult(twice_y_min))) {
+      llvm::Value *fits = builder.CreateICmpULT(x, y);
+      return builder.CreateSelect(fits, x, builder.CreateSub(x, y));
+    }
+
+    if (is_signed) {
+      return opcode == llvm::Instruction::UDiv ? builder.CreateUDiv(x, y)
+                                               : builder.CreateURem(x, y);
+    }
+    return nullptr;
+  }
+};
+
+} // namespace pcpo
@@ -0,0 +1,199 @@
+// pain-analyze: runs the analysis on many modules at once, without starting
+// opt and loading the plugin for each of them. Every input is parsed into its
+// own LLVMContext, so the inputs are analyzed in parallel. Bitcode is loaded
+// lazily: only the bodies of the functions that the analysis can reach are
+// read (see materialize in fixpoint.cpp).
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "fixpoint.h"
+#include "global.h"
+#include "parallel.h"
+#include "registry.h"
+
+using namespace llvm;
+
+static cl::list<std::string> Inputs(cl::Positional, cl::OneOrMore,
+                                    cl::desc("<input .ll or .bc files>"));
+
+static cl::opt<std::string>
+    Domain("domain",
+           cl::desc("Abstract domain: constant, interval, conjunction or "
+                    "subspace"),
+           cl::init("interval"));
+
+static cl::opt<std::string>
+    Engine("engine",
+           cl::desc("Fixpoint engine: simple, or widening followed by "
+                    "narrowing"),
+           cl::init("widening"));
+
+static cl::opt<std::string> OutputDirectory(
+    "o",
+    cl::desc("Write the states of each input to <directory>/<input>.pain "
+             "instead of stdout"),
+    cl::value_desc("directory"));
+
+static cl::opt<std::string> StatisticsFilename(
+    "statistics",
+    cl::desc("Write the statistics of every input as tab separated values to "
+             "filename, - for stdout"),
+    cl::value_desc("filename"));
+
+static cl::opt<unsigned>
+    Jobs("j", cl::desc("Number of inputs analyzed in parallel, 0 uses all cores"),
+         cl::init(0));
+
+static cl::opt<int> DebugLevel(
+    "debug-level",
+    cl::desc("Debug output of the fixpoint iteration, -1 for none, up to 4"),
+    cl::init(-1));
+
+namespace {
+
+struct Result {
+  pcpo::AnalysisStatistics statistics;
+  /// The states, unless they were written to the output directory
+  std::string output;
+  std::string error;
+  double seconds = 0;
+};
+
+/// Analyzes the input file and writes its states to out
+void analyze_input(std::string const &input, raw_ostream &out,
+                   Result &result) {
+  LLVMContext context;
+  SMDiagnostic diagnostic;
+  std::unique_ptr<Module> module =
+      getLazyIRFileModule(input, diagnostic, context);
+  if (!module) {
+    raw_string_ostream error{result.error};
+    diagnostic.print("pain-analyze", error);
+    return;
+  }
+  pcpo::analyze_module(*module, Domain, Engine, out, result.statistics);
+}
+
+/// Analyzes the input file, with the states going to the output directory if
+/// there is one
+void run(std::string const &input, Result &result) {
+  auto start = std::chrono::steady_clock::now();
+
+  if (OutputDirectory.empty()) {
+    raw_string_ostream out{result.output};
+    analyze_input(input, out, result);
+  } else {
+    // Inputs with the same name in different directories are kept apart
+    SmallString<128> path{OutputDirectory};
+    sys::path::append(path, sys::path::relative_path(input));
+    path += ".pain";
+    std::error_code error = sys::fs::create_directories(
+        sys::path::parent_path(path));
+    raw_fd_ostream out{path, error, sys::fs::OF_Text};
+    if (error) {
+      result.error = "pain-analyze: " + std::string(path) + ": " +
+                     error.message() + "\n";
+      return;
+    }
+    analyze_input(input, out, result);
+  }
+
+  std::chrono::duration<double> duration =
+      std::chrono::steady_clock::now() - start;
+  result.seconds = duration.count();
+}
+
+void write_statistics(std::vector<Result> const &results, raw_ostream &out) {
+  out << "input\tfunctions\tblocks\tnodes\tfixpoint\tseconds\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    Result const &result = results[i];
+    out << Inputs[i] << '\t';
+    if (!result.error.empty()) {
+      out << "error\n";
+      continue;
+    }
+    pcpo::AnalysisStatistics const &statistics = result.statistics;
+    out << statistics.functions << '\t' << statistics.blocks << '\t'
+        << statistics.nodes << '\t' << (statistics.fixpoint ? "yes" : "no")
+        << '\t' << format("%.3f", result.seconds) << '\n';
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  InitLLVM init{argc, argv};
+  cl::ParseCommandLineOptions(
+      argc, argv, "Abstract interpretation of many LLVM modules at once\n");
+  pcpo::debug_level = DebugLevel;
+
+  if (!pcpo::find_analysis(Domain, Engine)) {
+    errs() << "pain-analyze: unknown domain " << Domain << " or engine "
+           << Engine << '\n';
+    errs() << "Domains:";
+    for (std::string const &name : pcpo::registered_domains()) {
+      errs() << ' ' << name;
+    }
+    errs() << "\nEngines:";
+    for (std::string const &name : pcpo::registered_engines()) {
+      errs() << ' ' << name;
+    }
+    errs() << '\n';
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<Result> results(Inputs.size());
+  pcpo::run_parallel(Inputs.size(), Jobs,
+                     [&](size_t i) { run(Inputs[i], results[i]); });
+  std::chrono::duration<double> duration =
+      std::chrono::steady_clock::now() - start;
+
+  size_t failed = 0;
+  size_t unfinished = 0;
+  for (size_t i = 0; i < results.size(); ++i) {
+    Result const &result = results[i];
+    if (!result.error.empty()) {
+      errs() << result.error;
+      ++failed;
+      continue;
+    }
+    unfinished += !result.statistics.fixpoint;
+    if (!result.output.empty()) {
+      outs() << "; " << Inputs[i] << '\n' << result.output;
+    }
+  }
+
+  if (!StatisticsFilename.empty()) {
+    std::error_code error;
+    raw_fd_ostream out{StatisticsFilename, error, sys::fs::OF_Text};
+    if (error) {
+      errs() << "pain-analyze: " << StatisticsFilename << ": "
+             << error.message() << '\n';
+      return 1;
+    }
+    write_statistics(results, out);
+  }
+
+  errs() << "Analyzed " << results.size() - failed << " of " << results.size()
+         << " inputs in " << format("%.3f", duration.count()) << " s";
+  if (unfinished > 0) {
+    errs() << ", " << unfinished << " did not reach a fixpoint";
+  }
+  errs() << '\n';
+  return failed > 0 ? 1 : 0;
+}
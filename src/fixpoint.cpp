@@ -1,32 +1,169 @@
 #include "fixpoint.h"
 
+#include <algorithm>
+#include <map>
+#include <tuple>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Analysis/CFG.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 
 #include "global.h"
 
+#include "check_elimination.h"
 #include "constant_folding.h"
+#include "division_reduction.h"
+#include "induction_elimination.h"
 #include "integer_domain.h"
 #include "linear_subspace.h"
 #include "normalized_conjunction.h"
+#include "parallel.h"
+#include "range_annotation.h"
+#include "redundancy_elimination.h"
 #include "simple_interval.h"
+#include "switch_pruning.h"
+#include "trip_count_inference.h"
 #include "value_set.h"
+#include "width_narrowing.h"
 
-#include "fixpoint_widening.cpp"
+#include "fixpoint_engine.h"
 #include "hash_utils.h"
+#include "registry.h"
 
-#include "llvm/ADT/PostOrderIterator.h"
-
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
 #include "llvm/Support/raw_os_ostream.h"
 #include <fstream>
-static llvm::cl::opt<std::string> OutputFilename(
+
+namespace pcpo {
+
+// Options of the fixpoint engine, see fixpoint_engine.h
+llvm::cl::opt<std::string> OutputFilename(
     "vo", llvm::cl::desc("Specify the filename for the vizualization output"),
     llvm::cl::value_desc("filename"));
 
+llvm::cl::opt<unsigned> ContextDepth(
+    "pain-context-depth",
+    llvm::cl::desc("Maximum number of calls in the context of a function"),
+    llvm::cl::init(1));
+
+llvm::cl::opt<bool> AdaptiveContexts(
+    "pain-adaptive-contexts",
+    llvm::cl::desc("Only analyze a function in deeper contexts if its callers "
+                   "pass different arguments"));
+
+llvm::cl::opt<unsigned> ContextBudget(
+    "pain-context-budget",
+    llvm::cl::desc("Number of contexts after which a function is analyzed "
+                   "context-insensitively, with -pain-adaptive-contexts"),
+    llvm::cl::init(8));
+
+llvm::cl::opt<unsigned> Threads(
+    "pain-threads",
+    llvm::cl::desc("Number of threads analyzing independent entry points in "
+                   "library mode, 0 uses all cores"),
+    llvm::cl::init(1));
+
+llvm::cl::opt<bool> ExtendedBlocks(
+    "pain-extended-blocks",
+    llvm::cl::desc("Evaluate extended basic blocks as a unit, passing the "
+                   "state on to blocks with a single predecessor"));
+
+llvm::cl::opt<bool> DeltaStorage(
+    "pain-delta-states",
+    llvm::cl::desc("Store the states of the result as deltas against the "
+                   "state of the immediate dominator"));
+
+} // namespace pcpo
+
+static llvm::cl::opt<bool> LibraryMode(
+    "pain-library",
+    llvm::cl::desc("Analyze every externally visible function with unknown "
+                   "arguments, instead of only main"));
+
+enum class Transform {
+  Constants,
+  Ranges,
+  Widths,
+  Divisions,
+  Switches,
+  Specialize,
+  Checks,
+  Redundancy,
+  Inductions,
+  TripCounts
+};
+
+static llvm::cl::list<Transform> Transforms(
+    "pain-transform", llvm::cl::CommaSeparated,
+    llvm::cl::desc("Transformations to apply, constants if none is given"),
+    llvm::cl::values(
+        clEnumValN(Transform::Constants, "constants",
+                   "Fold constants and delete unreachable blocks"),
+        clEnumValN(Transform::Ranges, "ranges",
+                   "Add !range metadata and nsw/nuw flags from intervals"),
+        clEnumValN(Transform::Widths, "widths",
+                   "Compute integer arithmetic in the narrowest legal type "
+                   "that holds its interval"),
+        clEnumValN(Transform::Divisions, "divisions",
+                   "Replace divisions and remainders by cheaper instructions "
+                   "where intervals allow it"),
+        clEnumValN(Transform::Switches, "switches",
+                   "Remove switch cases that the condition never matches"),
+        clEnumValN(Transform::Specialize, "specialize",
+                   "Clone functions for call sites with constant arguments, "
+                   "and fold constants in the clones"),
+        clEnumValN(Transform::Checks, "checks",
+                   "Remove sanitizer overflow and bounds checks that "
+                   "intervals prove to never fire"),
+        clEnumValN(Transform::Redundancy, "redundancy",
+                   "Replace values by equal constants or dominating values, "
+                   "and multiplications by additions, from linear "
+                   "equalities"),
+        clEnumValN(Transform::Inductions, "inductions",
+                   "Compute induction variables that are affine in the "
+                   "primary one from it, and delete their recurrences"),
+        clEnumValN(Transform::TripCounts, "trip-counts",
+                   "Annotate loops with the bounds of their trip counts that "
+                   "intervals imply")));
+
+static llvm::cl::opt<std::string> ReportFilename(
+    "pain-report",
+    llvm::cl::desc("Write a report of the transformations to filename, - "
+                   "for stdout"),
+    llvm::cl::value_desc("filename"));
+
+static llvm::cl::opt<unsigned> SpecializeSize(
+    "pain-specialize-size",
+    llvm::cl::desc("Largest function, in instructions, that is cloned by "
+                   "-pain-transform=specialize"),
+    llvm::cl::init(200));
+
+static llvm::cl::opt<unsigned> SpecializeMax(
+    "pain-specialize-max",
+    llvm::cl::desc("Maximum number of clones of a function created by "
+                   "-pain-transform=specialize"),
+    llvm::cl::init(4));
+
+static llvm::cl::opt<std::string> DomainName(
+    "pain-domain",
+    llvm::cl::desc("Run the analysis with this domain and list its states in "
+                   "the report: constant, interval, conjunction or subspace"),
+    llvm::cl::value_desc("domain"));
+
+static llvm::cl::opt<std::string> EngineName(
+    "pain-engine",
+    llvm::cl::desc("Fixpoint engine of -pain-domain: simple, or widening "
+                   "followed by narrowing"),
+    llvm::cl::value_desc("engine"), llvm::cl::init("widening"));
+
 namespace pcpo {
 
 using namespace llvm;
@@ -41,446 +178,516 @@ static llvm::RegisterPass<AbstractInterpretationPass>
 char AbstractInterpretationPass::ID;
 
 int debug_level = DEBUG_LEVEL; // from global.hpp
+thread_local llvm::raw_ostream *debug_stream = nullptr;
 
-using Callstring = vector<Function const *>;
-using NodeKey = pair<Callstring, BasicBlock const *>;
-
-// MARK: - To String
-
-template <typename T> T &operator<<(T &os, BasicBlock const &basic_block) {
-  os << "%";
-  if (llvm::Function const *f = basic_block.getParent()) {
-    os << f->getName() << ".";
+llvm::raw_ostream &report() {
+  static std::unique_ptr<llvm::raw_fd_ostream> stream;
+  static bool failed = false;
+  if (ReportFilename.empty() || failed) {
+    return llvm::nulls();
   }
-  return os << basic_block.getName();
-}
-
-template <typename T> T &operator<<(T &os, Callstring const &callstring) {
-  for (auto call : callstring) {
-    os << std::string(call->getName());
-    if (call != callstring.back()) {
-      os << " -> ";
+  if (!stream) {
+    std::error_code error;
+    stream = std::make_unique<llvm::raw_fd_ostream>(ReportFilename, error,
+                                                    llvm::sys::fs::OF_Text);
+    if (error) {
+      // A stream that failed to open reports an error when it is destroyed,
+      // so it is not kept. The report is dropped instead.
+      dbgs(0) << "Could not open " << ReportFilename << ": "
+              << error.message() << '\n';
+      stream.reset();
+      failed = true;
+      return llvm::nulls();
     }
   }
-  return os;
-}
-
-template <typename T> T &operator<<(T &os, NodeKey const &key) {
-  return os << "[" << *key.second << "," << key.first << "]";
+  return *stream;
 }
 
-template <typename AbstractState> struct Node {
-  BasicBlock const *basic_block;
-  /// Function calls the lead to this basic block. The last element is always
-  /// the current function.
-  Callstring callstring;
-  AbstractState state = {};
-  bool update_scheduled = false; // Whether the node is already in the worklist
-
-  /// Check wether this basic block is the entry block of its function.
-  bool isEntry() const { return basic_block == &function()->getEntryBlock(); }
-
-  /// Function in which this basic block is located.
-  Function const *function() const { return callstring.back(); }
-};
+// MARK: - Contexts
 
 Callstring callstring_for(Function const *function,
                           Callstring const &callstring, int max_length) {
-  Callstring new_callstring;
-  for (auto call : callstring) {
-    if (max_length-- > 0) {
-      new_callstring.push_back(call);
-    } else {
-      return new_callstring;
-    }
-  }
+  // The most recent calls are at the end
+  size_t kept = std::min<size_t>(callstring.size(), std::max(max_length, 0));
+  Callstring new_callstring(callstring.end() - kept, callstring.end());
   new_callstring.push_back(function);
   return new_callstring;
 }
 
-template <typename AbstractState>
-vector<Node<AbstractState> *>
-register_function(llvm::Function const *function, Callstring const &callstring,
-                  int callstack_depth,
-                  unordered_map<pcpo::NodeKey, Node<AbstractState>> &nodes) {
-  Callstring new_callstring =
-      callstring_for(function, callstring, callstack_depth);
-  vector<Node<AbstractState> *> inserted_nodes;
-
-  for (po_iterator<BasicBlock const *> I = po_begin(&function->getEntryBlock()),
-                                       IE = po_end(&function->getEntryBlock());
-       I != IE; ++I) {
-
-    BasicBlock const *basic_block = *I;
-
-    dbgs(1) << "  Found basic block: " << basic_block->getName() << '\n';
-    NodeKey key = {new_callstring, basic_block};
-    Node<AbstractState> node = {basic_block, new_callstring};
-    if (node.isEntry()) {
-      node.state = AbstractState{*node.function()};
+// MARK: - Entry points
+
+/// Reads the body of function if its module was loaded lazily, e.g. by
+/// pain-analyze. Returns whether function has a body. A body that cannot be
+/// read is reported, and the function is treated like an external one.
+bool materialize(Function const &function) {
+  if (function.isMaterializable()) {
+    dbgs(1) << "Reading function " << function.getName() << '\n';
+    if (Error error = const_cast<Function &>(function).materialize()) {
+      logAllUnhandledErrors(std::move(error), errs(),
+                            "Could not read " + function.getName() + ": ");
     }
-    inserted_nodes.push_back(&nodes[key]);
-    nodes[key] = node;
-  }
-  return inserted_nodes;
-}
-
-template <typename AbstractState>
-void add_to_worklist(vector<Node<AbstractState> *> &nodes,
-                     vector<Node<AbstractState> *> &worklist) {
-  for (Node<AbstractState> *node : nodes) {
-    node->update_scheduled = true;
-    worklist.push_back(node);
   }
+  return !function.empty();
 }
 
-// Run the simple fixpoint algorithm with callstrings. AbstractState should
-// implement the interface documented in AbstractStateDummy (no need to subclass
-// or any of that, just implement the methods with the right signatures and take
-// care to fulfil the contracts outlines above). Note that a lot of this code is
-// duplicated in executeFixpointAlgorithmWidening in fixpoint_widening.cpp, so
-// if you fix any bugs in here, they probably should be fixed there as well.
-//  Tip: Look at a diff of fixpoint.cpp and fixpoint_widening.cpp with a visual
-//  diff tool (I
-// recommend Meld.)
-template <typename AbstractState, int iterations_max = 1000,
-          int callstack_depth = 1,
-          Merge_op::Type merge_op = Merge_op::UPPER_BOUND>
-unordered_map<NodeKey, Node<AbstractState>>
-executeFixpointAlgorithm(Module const &M) {
-  using Node = Node<AbstractState>;
-
-  // A node in the control flow graph, i.e. a basic block. Here, we need a bit
-  // of additional data per node to execute the fixpoint algorithm.
-
-  unordered_map<NodeKey, Node> nodes;
-  vector<Node *> worklist;
-
-  // We only consider the main function in the beginning. If no main exists,
-  // nothing is evaluated!
+vector<Function const *> entry_points(Module const &M) {
   Function const *main_func = M.getFunction("main");
+  if (main_func && !LibraryMode && materialize(*main_func)) {
+    return {main_func};
+  }
+  if (!LibraryMode) {
+    dbgs(0) << "No main function, analyzing all externally visible "
+               "functions\n";
+  }
 
-  // TODO: Check what this does for release clang, probably write out a warning
-  dbgs(1) << "Initialising fixpoint algorithm, collecting basic blocks\n";
-
-  // Register basic blocks of the main function
-  auto main_basic_blocks =
-      register_function(main_func, {}, callstack_depth, nodes);
-  add_to_worklist(main_basic_blocks, worklist);
-
-  dbgs(1) << "\nWorklist initialised with " << worklist.size()
-          << (worklist.size() != 1 ? " entries" : " entry")
-          << ". Starting fixpoint iteration...\n";
-
-  for (int iter = 0; !worklist.empty() and iter < iterations_max; ++iter) {
-    Node &node = *worklist.back();
-    worklist.pop_back();
-    node.update_scheduled = false;
-
-    dbgs(1) << "\nIteration " << iter << ", considering basic block "
-            << *node.basic_block << " with callstring " << node.callstring
-            << '\n';
+  vector<Function const *> roots;
+  for (Function const &function : M) {
+    if (!function.hasLocalLinkage() && materialize(function)) {
+      roots.push_back(&function);
+    }
+  }
+  return roots;
+}
 
-    AbstractState state_new; // Set to bottom
+/// Defined functions that are reachable from root through direct calls. Their
+/// bodies are read on the way (see materialize), all others are never read.
+std::unordered_set<Function const *> reachable_functions(Function const *root) {
+  std::unordered_set<Function const *> reachable = {root};
+  vector<Function const *> stack = {root};
+  while (!stack.empty()) {
+    Function const *function = stack.back();
+    stack.pop_back();
+    for (BasicBlock const &basic_block : *function) {
+      for (Instruction const &inst : basic_block) {
+        if (CallInst const *call = dyn_cast<CallInst>(&inst)) {
+          Function const *callee = call->getCalledFunction();
+          if (callee && !reachable.count(callee) && materialize(*callee)) {
+            reachable.insert(callee);
+            stack.push_back(callee);
+          }
+        }
+      }
+    }
+  }
+  return reachable;
+}
 
-    if (node.isEntry()) {
-      dbgs(1) << "  Merging function parameters, is entry block\n";
+void materialize_reachable(vector<Function const *> const &roots) {
+  if (roots.empty() || roots.front()->getParent()->isMaterialized()) {
+    return;
+  }
+  for (Function const *root : roots) {
+    reachable_functions(root);
+  }
+}
 
-      // if it is the entry node, then its state should be top
-      state_new.merge(merge_op, node.state);
-      state_new.isBottom = false;
+vector<vector<Function const *>>
+independent_groups(vector<Function const *> const &roots) {
+  vector<int> group(roots.size());
+  for (size_t i = 0; i < roots.size(); ++i) {
+    group[i] = i;
+  }
+  auto find = [&group](int i) {
+    while (group[i] != i) {
+      i = group[i] = group[group[i]];
     }
+    return i;
+  };
+
+  // Entry point that first reached a function
+  unordered_map<Function const *, int> owner;
+  for (size_t i = 0; i < roots.size(); ++i) {
+    for (Function const *function : reachable_functions(roots[i])) {
+      auto [it, inserted] = owner.insert({function, i});
+      if (!inserted) {
+        group[find(i)] = find(it->second);
+      }
+    }
+  }
 
-    dbgs(1) << "  Merge of " << pred_size(node.basic_block)
-            << (pred_size(node.basic_block) != 1 ? " predecessors.\n"
-                                                 : " predecessor.\n");
+  vector<vector<Function const *>> groups;
+  unordered_map<int, int> index;
+  for (size_t i = 0; i < roots.size(); ++i) {
+    auto [it, inserted] = index.insert({find(i), groups.size()});
+    if (inserted) {
+      groups.emplace_back();
+    }
+    groups[it->second].push_back(roots[i]);
+  }
+  return groups;
+}
 
-    // Collect the predecessors
-    vector<AbstractState> predecessors;
-    for (BasicBlock const *basic_block : llvm::predecessors(node.basic_block)) {
-      dbgs(3) << "    Merging basic block " << *basic_block << '\n';
+// Rewrite the analyzed ones of functions with the states of their blocks,
+// joined over all contexts (see ConstantFolding::transformFunction). The
+// states are joined once, so this is linear in the size of the functions. If
+// the iteration was cut off, the states are not sound, and nothing is changed.
+template <typename AbstractState>
+bool optimize(vector<Function *> const &functions,
+              BlockStates<AbstractState> const &states) {
+  if (!states.isFixpoint()) {
+    dbgs(0) << "The analysis did not reach a fixpoint, skipping the "
+               "transformation\n";
+    return false;
+  }
 
-      AbstractState state_branched{
-          nodes[{{node.callstring}, basic_block}].state};
-      state_branched.branch(*basic_block, *node.basic_block);
-      state_new.merge(merge_op, state_branched);
-      predecessors.push_back(state_branched);
+  bool hasChanged = false;
+  for (Function *func : functions) {
+    // Functions that were never called have no states
+    if (func->isDeclaration() || !states.reached(&func->getEntryBlock())) {
+      continue;
     }
+    hasChanged |= AbstractState::transformFunction(
+        *func, [&states](BasicBlock const *basic_block) {
+          return states.joined(basic_block);
+        });
+  }
 
-    dbgs(2) << "  Relevant incoming state is:\n";
-    state_new.printIncoming(*node.basic_block, dbgs(2), 4);
-
-    // Apply the basic block
-    dbgs(3) << "  Applying basic block\n";
+  return hasChanged;
+} // namespace pcpo
 
-    if (state_new.isBottom) {
-      dbgs(3) << "    Basic block is unreachable, everything is bottom\n";
-    } else {
-      // Applies all instrucions of a basic block
-      for (Instruction const &inst : *node.basic_block) {
+// Rewrite every analyzed function of the module, see above. Nodes that are
+// passed as an rvalue are released while their states are joined.
+template <typename AbstractState, typename Nodes>
+bool optimize(llvm::Module &M, Nodes &&nodes2AbstractStateNode) {
+  vector<Function *> functions;
+  for (Function &func : M) {
+    functions.push_back(&func);
+  }
+  BlockStates<AbstractState> states{
+      std::forward<Nodes>(nodes2AbstractStateNode)};
+  return optimize<AbstractState>(functions, states);
+}
 
-        // Handles return instructions
-        if (isa<ReturnInst>(&inst)) {
-          state_new.applyReturnInst(inst);
-        }
+// Whether the transformation was selected with -pain-transform
+bool transform_enabled(Transform transform) {
+  if (Transforms.empty()) {
+    return transform == Transform::Constants;
+  }
+  return std::find(Transforms.begin(), Transforms.end(), transform) !=
+         Transforms.end();
+}
 
-        // If the result of the instruction is not used, there is no reason to
-        // compute it. (There are no side-effects in LLVM IR. (I hope.))
-        // if (inst.use_empty()) {
-        //   // Except for call instructions, we still want to get that
-        //   information if (not isa<CallInst>(&inst)) {
-        //     dbgs(3) << "    Empty use of instruction, " <<
-        //     inst.getOpcodeName()
-        //             << " skipping...\n";
-        //     continue;
-        //   }
-        // }
-
-        // Handles merging points
-        if (isa<PHINode>(&inst)) {
-          state_new.applyPHINode(*node.basic_block, predecessors, inst);
-
-          // Handles function calls
-        } else if (CallInst const *call = dyn_cast<CallInst>(&inst)) {
-
-          // Checks if an input parameter for the callee is bottom. If so,
-          // then skip the calculation of the call instruction for now
-          if (state_new.checkOperandsForBottom(inst))
-            continue;
-
-          Function const *callee_func = call->getCalledFunction();
-
-          // Checks for functions, such as printf and skips them
-          if (callee_func->empty()) {
-            dbgs(3) << "    Function " << callee_func->getName()
-                    << " is external, skipping...\n";
-            continue;
-          }
+// Annotate the module with the results of an interval analysis. Intervals have
+// infinite ascending chains, so this needs widening.
+bool annotate_ranges(Module &M) {
+  auto analysisData =
+      executeFixpointAlgorithm<RangeAnnotation, 1000, Merge_op::WIDEN>(M);
+  return optimize<RangeAnnotation>(M, std::move(analysisData));
+}
 
-          Callstring new_callstring =
-              callstring_for(callee_func, node.callstring, callstack_depth);
-
-          NodeKey callee_element = {new_callstring,
-                                    &callee_func->getEntryBlock()};
-          vector<Node *> callee_basic_blocks;
-          bool changed;
-
-          // Checks whether a node with key [%callee entry block, %caller basic
-          // block], i.e. an entry block with callstring of caller basic block,
-          // exists. If not, all nodes with their corrosponding keys are
-          // initilized for the callee function.
-          if (nodes.find(callee_element) == nodes.end()) {
-            // Check if abstract_state of call.bb is bottom or not
-            dbgs(3) << "    No information regarding function call %"
-                    << call->getCalledFunction()->getName() << "\n";
-
-            callee_basic_blocks = register_function(
-                callee_func, node.callstring, callstack_depth, nodes);
-
-            nodes[callee_element].state =
-                AbstractState{callee_func, state_new, call};
-            changed = true;
-          } else {
-            // update callee
-            AbstractState before = nodes[callee_element].state;
-
-            // Collect all basic blocks of callee_func
-            for (po_iterator<BasicBlock const *>
-                     I = po_begin(&callee_func->getEntryBlock()),
-                     IE = po_end(&callee_func->getEntryBlock());
-                 I != IE; ++I) {
-              BasicBlock const *basic_block = *I;
-              NodeKey key = {new_callstring, basic_block};
-              callee_basic_blocks.push_back(&nodes[key]);
-            }
-
-            AbstractState state_update{callee_func, state_new, call};
-            changed = nodes[callee_element].state.merge(merge_op, state_update);
-          }
+// Narrow integer arithmetic to the widths its intervals need
+bool narrow_widths(Module &M) {
+  auto analysisData =
+      executeFixpointAlgorithm<WidthNarrowing, 1000, Merge_op::WIDEN>(M);
+  return optimize<WidthNarrowing>(M, std::move(analysisData));
+}
 
-          // Getting the last block
-          BasicBlock const *end_block = &*std::prev(callee_func->end());
-          NodeKey end_element = {new_callstring, end_block};
-          state_new.applyCallInst(inst, end_block, nodes[end_element].state);
-
-          // If input parameters have changed, we want to interpret the function
-          // once again and reevaluate the nodes of possible callers.
-          if (changed) {
-            for (auto &[key, value] : nodes) {
-              if (key.second == node.basic_block and
-                  not value.update_scheduled) {
-                dbgs(3) << "      Adding possible caller " << key
-                        << " to worklist\n";
-                worklist.push_back(&value);
-                value.update_scheduled = true;
-              }
-            }
-
-            // Checks if the key of the callee functions entry node is already
-            // on the worklist, this is necessary for recursions.
-            for (Node *elem : callee_basic_blocks) {
-              if (!elem->update_scheduled) {
-                worklist.push_back(elem);
-                elem->update_scheduled = true;
-
-                dbgs(3) << "      Adding callee " << *elem->basic_block << " "
-                        << elem->callstring << " to worklist\n";
-              } else {
-                dbgs(3)
-                    << "      Callee already on worklist, nothing to add...\n";
-              }
-            }
-          }
-        } else {
-          if (state_new.checkOperandsForBottom(inst))
-            continue;
-          state_new.applyDefault(inst);
-        }
-      }
-    }
+// Strength-reduce divisions and remainders with the help of intervals
+bool reduce_divisions(Module &M) {
+  auto analysisData =
+      executeFixpointAlgorithm<DivisionReduction, 1000, Merge_op::WIDEN>(M);
+  return optimize<DivisionReduction>(M, std::move(analysisData));
+}
 
-    // Merge the state back into the node
-    dbgs(3) << "  Merging with stored state\n";
-    bool changed = node.state.merge(merge_op, state_new);
+// Remove the switch cases that intervals show to be dead
+bool prune_switches(Module &M) {
+  auto analysisData =
+      executeFixpointAlgorithm<SwitchPruning, 1000, Merge_op::WIDEN>(M);
+  return optimize<SwitchPruning>(M, std::move(analysisData));
+}
 
-    dbgs(2) << "  Outgoing state " << (changed ? "changed" : "didn't change")
-            << ":\n";
-    state_new.printOutgoing(*node.basic_block, dbgs(2), 4);
+// Attach the trip counts that intervals imply to the loops
+bool infer_trip_counts(Module &M) {
+  auto analysisData =
+      executeFixpointAlgorithm<TripCountInference, 1000, Merge_op::WIDEN>(M);
+  return optimize<TripCountInference>(M, std::move(analysisData));
+}
 
-    // No changes, so no need to do anything else
-    if (not changed)
-      continue;
+// Remove sanitizer checks that cannot fire
+bool eliminate_checks(Module &M) {
+  auto analysisData =
+      executeFixpointAlgorithm<CheckElimination, 1000, Merge_op::WIDEN>(M);
+  return optimize<CheckElimination>(M, std::move(analysisData));
+}
 
-    dbgs(2) << "  State changed, notifying " << succ_size(node.basic_block)
-            << (succ_size(node.basic_block) != 1 ? " successors\n"
-                                                 : " successor\n");
+// Remove computations that linear equalities show to be redundant. The
+// equalities form a lattice of finite height, so no widening is needed.
+bool eliminate_redundancy(Module &M) {
+  auto analysisData = executeFixpointAlgorithm<RedundancyElimination>(M);
+  return optimize<RedundancyElimination>(M, std::move(analysisData));
+}
 
-    // Something changed and we will need to update the successors
-    for (BasicBlock const *succ_bb : successors(node.basic_block)) {
-      NodeKey succ_key = {{node.callstring}, succ_bb};
-      Node &succ = nodes[succ_key];
-      if (not succ.update_scheduled) {
-        worklist.push_back(&succ);
-        succ.update_scheduled = true;
+// Remove induction variables that affine relations show to be redundant
+bool eliminate_inductions(Module &M) {
+  auto analysisData = executeFixpointAlgorithm<InductionVariableElimination>(M);
+  return optimize<InductionVariableElimination>(M, std::move(analysisData));
+}
 
-        dbgs(3) << "    Adding " << succ_key << " to worklist\n";
+// MARK: - Specialization
+
+/// Arguments of a call that are constant, as argument number and value
+using ConstantArguments = vector<pair<unsigned, Constant *>>;
+
+/// Number of instructions of function that depend on the arguments, directly
+/// or through other instructions. Sets decides_branch if a conditional branch
+/// or switch is among them, as its dead successors can be deleted.
+unsigned dependent_instructions(Function &function,
+                                ConstantArguments const &arguments,
+                                bool &decides_branch) {
+  std::unordered_set<Value *> dependent;
+  vector<Value *> stack;
+  for (auto [number, constant] : arguments) {
+    stack.push_back(function.getArg(number));
+  }
+  decides_branch = false;
+  while (!stack.empty()) {
+    Value *value = stack.back();
+    stack.pop_back();
+    for (User *user : value->users()) {
+      auto inst = dyn_cast<Instruction>(user);
+      if (!inst || !dependent.insert(inst).second) {
+        continue;
       }
+      decides_branch |= isa<BranchInst>(inst) || isa<SwitchInst>(inst);
+      stack.push_back(inst);
     }
   }
+  return dependent.size();
+}
 
-  if (!worklist.empty()) {
-    dbgs(0) << "Iteration terminated due to exceeding loop count.\n";
+// Clone functions for the constant arguments of their call sites. The entry
+// state of a call is built like in the fixpoint iteration, from the state of
+// its block joined over all contexts. Calls passing the same constants share a
+// clone, in which these arguments are replaced by the constants. A clone is
+// only made if the function is at most -pain-specialize-size instructions
+// large, and the constants decide a branch or a quarter of the function
+// depends on them. Each function gets at most -pain-specialize-max clones,
+// for the groups of calls that benefit the most. Finally, the module is
+// analyzed again and constants are folded in the clones, which simplifies them.
+// The other functions are only folded with -pain-transform=constants.
+bool specialize_functions(Module &M) {
+  using AbstractState = ConstantFolding<IntegerDomain>;
+  BlockStates<AbstractState> states{executeFixpointAlgorithm<AbstractState>(M)};
+  if (!states.isFixpoint()) {
+    dbgs(0) << "The analysis did not reach a fixpoint, skipping the "
+               "specialization\n";
+    return false;
   }
 
-  std::ofstream Res(OutputFilename.c_str());
-  unsigned int y = 0;
-  if (Res.good()) {
-    dbgs(0) << "Output filename: " << OutputFilename.c_str();
-
-    std::error_code ErrInfo;
-    llvm::raw_fd_ostream Result(OutputFilename.c_str(), ErrInfo,
-                                llvm::sys::fs::F_None);
-    StringRef sofar("");
-    Result << "{\n";
-    for (auto const &[key, node] : nodes) {
-      StringRef name = (*node.basic_block).getParent()->getName();
+  std::map<pair<Function *, ConstantArguments>, vector<CallInst *>> groups;
+  unordered_map<Function *, unsigned> call_count;
+  for (Function &function : M) {
+    for (BasicBlock &basic_block : function) {
+      AbstractState state = states.joined(&basic_block);
+      if (state.isBottom) {
+        continue;
+      }
+      for (Instruction &inst : basic_block) {
+        auto call = dyn_cast<CallInst>(&inst);
+        Function *callee = call ? call->getCalledFunction() : nullptr;
+        if (!callee || callee->isDeclaration() || callee->isVarArg()) {
+          continue;
+        }
+        ++call_count[callee];
 
-      if (!sofar.equals(name)) {
-        if (sofar.size() != 0)
-          Result << "},\n";
-        Result << "\"" << name << "\":{\n";
-        sofar = name;
+        AbstractState entry{callee, state, call};
+        ConstantArguments arguments;
+        for (Argument const &arg : callee->args()) {
+          if (auto constant = entry.constantOf(arg)) {
+            arguments.push_back({arg.getArgNo(), constant.value()});
+          }
+        }
+        if (!arguments.empty()) {
+          groups[{callee, arguments}].push_back(call);
+        }
       }
-      Result << "  \"" << (*node.basic_block).getName() << "\""
-             << ":{\n";
-      node.state.printOutgoing(*node.basic_block, Result, 4);
-      Result << "  }";
-      if (y++ != nodes.size() - 1)
-        Result << ",";
-      Result << "\n";
     }
-    Result << "}}\n";
-    Result.flush();
   }
 
-  // Output the final result
-  dbgs(0) << "\nFinal result:\n";
-  for (auto const &[key, node] : nodes) {
-    dbgs(0) << key << ":\n";
-    node.state.printOutgoing(*node.basic_block, dbgs(0), 2);
+  struct Candidate {
+    Function *callee;
+    ConstantArguments const *arguments;
+    vector<CallInst *> const *calls;
+    unsigned benefit;
+  };
+  vector<Candidate> candidates;
+  for (auto const &[key, calls] : groups) {
+    auto const &[callee, arguments] = key;
+    unsigned size = callee->getInstructionCount();
+    if (size > SpecializeSize) {
+      continue;
+    }
+    // If every call passes the constants, folding already sees them
+    if (callee->hasLocalLinkage() && calls.size() == call_count[callee]) {
+      continue;
+    }
+    bool decides_branch;
+    unsigned dependent =
+        dependent_instructions(*callee, arguments, decides_branch);
+    if (!decides_branch && dependent * 4 < size) {
+      continue;
+    }
+    candidates.push_back(
+        {callee, &arguments, &calls, dependent * unsigned(calls.size())});
+  }
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](Candidate const &a, Candidate const &b) {
+                     return a.benefit > b.benefit;
+                   });
+
+  unordered_map<Function *, unsigned> clone_count;
+  vector<Function *> clones;
+  for (Candidate const &candidate : candidates) {
+    if (clone_count[candidate.callee]++ >= SpecializeMax) {
+      continue;
+    }
+    ValueToValueMapTy value_map;
+    Function *clone = CloneFunction(candidate.callee, value_map);
+    clone->setName(candidate.callee->getName() + ".specialized");
+    clone->setLinkage(GlobalValue::InternalLinkage);
+    for (auto [number, constant] : *candidate.arguments) {
+      clone->getArg(number)->replaceAllUsesWith(constant);
+    }
+    for (CallInst *call : *candidate.calls) {
+      call->setCalledFunction(clone);
+    }
+    dbgs(1) << "Specialized " << candidate.callee->getName() << " as "
+            << clone->getName() << " for " << candidate.calls->size()
+            << (candidate.calls->size() != 1 ? " calls\n" : " call\n");
+    clones.push_back(clone);
+  }
+  if (clones.empty()) {
+    return false;
   }
 
-  return nodes;
+  // The states of the first analysis are not needed anymore
+  states =
+      BlockStates<AbstractState>{executeFixpointAlgorithm<AbstractState>(M)};
+  optimize<AbstractState>(clones, states);
+  return true;
 }
 
-template <typename AbstractState>
-bool optimize(
-    llvm::Module &M,
-    const unordered_map<NodeKey, Node<AbstractState>> nodes2AbstractStateNode) {
-  bool hasChanged = false;
+// MARK: - Selected analysis
+
+// The constant folding of the transformation is the constant domain of the
+// registry, which is instantiated in analysis_constant_simple.cpp
+extern template unordered_map<NodeKey, Node<ConstantFolding<IntegerDomain>>>
+executeFixpointAlgorithm<ConstantFolding<IntegerDomain>, 1000,
+                         Merge_op::UPPER_BOUND>(Module const &M);
+
+// Run the analysis selected with -pain-domain and -pain-engine, and list the
+// states of its blocks in the report
+void run_selected_analysis(Module const &M) {
+  AnalysisFunction analysis = find_analysis(DomainName, EngineName);
+  if (!analysis) {
+    report_fatal_error(Twine("Unknown -pain-domain=") + DomainName +
+                       " or -pain-engine=" + EngineName);
+  }
+  AnalysisStatistics statistics;
+  analysis(M, report(), statistics);
+}
 
-  for (auto func = M.begin(); func != M.end(); func++) {
-    for (Function::iterator bb = func->begin(), bbe = func->end(); bb != bbe;
-         ++bb) {
+// Run the analysis selected with -pain-domain and the transformations selected
+// with -pain-transform, in a fixed order. The pass managers get the states of
+// the constant domain differently, so constants are folded by fold_constants.
+bool run_transforms(Module &M, llvm::function_ref<bool()> fold_constants) {
+  if (!DomainName.empty()) {
+    run_selected_analysis(M);
+  }
+  bool changed = false;
+  if (transform_enabled(Transform::Constants)) {
+    changed |= fold_constants();
+  }
+  if (transform_enabled(Transform::Specialize)) {
+    changed |= specialize_functions(M);
+  }
+  if (transform_enabled(Transform::Checks)) {
+    changed |= eliminate_checks(M);
+  }
+  if (transform_enabled(Transform::Redundancy)) {
+    changed |= eliminate_redundancy(M);
+  }
+  if (transform_enabled(Transform::Inductions)) {
+    changed |= eliminate_inductions(M);
+  }
+  if (transform_enabled(Transform::Ranges)) {
+    changed |= annotate_ranges(M);
+  }
+  if (transform_enabled(Transform::Switches)) {
+    changed |= prune_switches(M);
+  }
+  if (transform_enabled(Transform::Divisions)) {
+    changed |= reduce_divisions(M);
+  }
+  if (transform_enabled(Transform::Widths)) {
+    changed |= narrow_widths(M);
+  }
+  if (transform_enabled(Transform::TripCounts)) {
+    changed |= infer_trip_counts(M);
+  }
+  return changed;
+}
 
-      BasicBlock const &tmpBB = *bb;
-      Callstring callstring =
-          callstring_for(M.getFunction(func->getName()), {}, 1);
+bool AbstractInterpretationPass::runOnModule(llvm::Module &M) {
+  return run_transforms(M, [&M]() {
+    auto analysisData =
+        executeFixpointAlgorithm<ConstantFolding<IntegerDomain>>(M);
+    return optimize<ConstantFolding<IntegerDomain>>(M, std::move(analysisData));
+  });
+}
 
-      NodeKey key = {callstring, &tmpBB};
+void AbstractInterpretationPass::getAnalysisUsage(
+    llvm::AnalysisUsage &info) const {}
 
-      auto acc = AbstractState();
+// MARK: - New pass manager
 
-      for (const auto &[nodeKey, nodeState] : nodes2AbstractStateNode) {
-        if (nodeKey.second == &tmpBB) {
-          acc.merge(Merge_op::UPPER_BOUND, nodeState.state);
-        }
-      }
+AnalysisKey AbstractInterpretationAnalysis::Key;
 
-      // Collect the predecessors
-      vector<AbstractState> predecessors;
-      for (BasicBlock const *basic_block : llvm::predecessors(&tmpBB)) {
-        for (const auto &[nodeKey, nodeState] : nodes2AbstractStateNode) {
-          if (nodeKey.second == basic_block) {
-            AbstractState state_branched{nodeState.state};
-            predecessors.push_back(state_branched);
-          }
-        }
-      }
+AbstractInterpretationAnalysis::Result
+AbstractInterpretationAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
+  return executeFixpointAlgorithm<AbstractState>(M);
+}
 
-      for (Instruction &inst : *bb) {
-        if (isa<PHINode>(inst)) {
-          hasChanged |= acc.transformPHINode(*bb, predecessors, inst);
-        } else {
-          hasChanged |= acc.transformDefault(inst);
-        }
-      }
-    }
+PreservedAnalyses
+AbstractInterpretationTransformPass::run(Module &M,
+                                         ModuleAnalysisManager &MAM) {
+  using AbstractState = AbstractInterpretationAnalysis::AbstractState;
+  bool changed = run_transforms(M, [&M, &MAM]() {
+    auto const &nodes = MAM.getResult<AbstractInterpretationAnalysis>(M);
+    return optimize<AbstractState>(M, nodes);
+  });
+  if (!changed) {
+    return PreservedAnalyses::all();
   }
 
-  return hasChanged;
-} // namespace pcpo
-
-bool AbstractInterpretationPass::runOnModule(llvm::Module &M) {
-  // using AbstractState = AbstractStateValueSet<SimpleInterval>;
-  //     Use either the standard fixpoint algorithm or the version with
-  //     widening
-  // executeFixpointAlgorithm<AbstractState>(M);
-  auto analysisData =
-      executeFixpointAlgorithm<ConstantFolding<IntegerDomain>>(M);
-  return optimize<ConstantFolding<IntegerDomain>>(M, analysisData);
-
-  //     executeFixpointAlgorithm<NormalizedConjunction>(M);
-  //    executeFixpointAlgorithm<LinearSubspace>(M);
-  //    executeFixpointAlgorithmWidening<AbstractState>(M);
-
-  // We never change anything
-  // return false;
+  // The states refer to instructions and blocks that were erased
+  return PreservedAnalyses::none();
 }
 
-void AbstractInterpretationPass::getAnalysisUsage(
-    llvm::AnalysisUsage &info) const {
-  info.setPreservesAll();
+static void registerCallbacks(PassBuilder &PB) {
+  PB.registerAnalysisRegistrationCallback([](ModuleAnalysisManager &MAM) {
+    MAM.registerPass([] { return AbstractInterpretationAnalysis(); });
+  });
+  PB.registerPipelineParsingCallback(
+      [](StringRef name, ModulePassManager &MPM,
+         ArrayRef<PassBuilder::PipelineElement>) {
+        if (name == "painpass") {
+          MPM.addPass(AbstractInterpretationTransformPass());
+          return true;
+        }
+        if (name == "require<painanalysis>") {
+          MPM.addPass(
+              RequireAnalysisPass<AbstractInterpretationAnalysis, Module>());
+          return true;
+        }
+        return false;
+      });
 }
 
 } /* end of namespace pcpo */
+
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
+llvmGetPassPluginInfo() {
+  return {LLVM_PLUGIN_API_VERSION, "AbstractInterpretation", "v0.1",
+          pcpo::registerCallbacks};
+}
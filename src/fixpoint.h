@@ -1,9 +1,137 @@
 #pragma once
 
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/PassManager.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+
+#include "constant_folding.h"
+#include "delta_states.h"
+#include "general.h"
+#include "hash_utils.h"
+#include "integer_domain.h"
 
 namespace pcpo {
 
+using Callstring = std::vector<llvm::Function const *>;
+using NodeKey = std::pair<Callstring, llvm::BasicBlock const *>;
+
+template <typename AbstractState> struct Node {
+    llvm::BasicBlock const *basic_block;
+    /// Function calls the lead to this basic block. The last element is always
+    /// the current function.
+    Callstring callstring;
+    AbstractState state = {};
+    bool update_scheduled = false; // Whether the node is already in the worklist
+    int change_count = 0; // How often the state changed, to decide when to widen or stop narrowing
+
+    /// Check wether this basic block is the entry block of its function.
+    bool isEntry() const { return basic_block == &function()->getEntryBlock(); }
+
+    /// Function in which this basic block is located.
+    llvm::Function const *function() const { return callstring.back(); }
+};
+
+/// Whether BlockStates stores the joined states as deltas, defined in fixpoint.cpp
+extern llvm::cl::opt<bool> DeltaStorage;
+
+/// States of the fixpoint, indexed by basic block. This is built once after the analysis, so that
+/// the transformation does not need to search all nodes for the contexts of a block.
+///
+/// The states are joined over the contexts one function at a time. With -pain-delta-states, the
+/// joined states of domains that support it are then moved to DeltaStates right away. Built from
+/// nodes that are passed as an rvalue, the nodes of a function are released once it is joined, so
+/// the nodes and the joined states are never all kept at once.
+template <typename AbstractState> class BlockStates {
+    using Nodes = std::unordered_map<NodeKey, Node<AbstractState>>;
+
+public:
+    explicit BlockStates(Nodes const& nodes) { join(nodes); }
+    explicit BlockStates(Nodes&& nodes) { join(nodes); }
+
+    /// Whether the iteration finished. Otherwise, the states are not sound.
+    bool isFixpoint() const { return fixpoint_; }
+
+    /// Whether the block was reached in some context.
+    bool reached(llvm::BasicBlock const* basic_block) const {
+        if constexpr (has_delta<AbstractState>) {
+            if (deltas_.contains(basic_block)) return true;
+        }
+        return joined_.count(basic_block) != 0;
+    }
+
+    /// Upper bound of the states of the block in all contexts, bottom if it was never reached.
+    AbstractState joined(llvm::BasicBlock const* basic_block) const {
+        if constexpr (has_delta<AbstractState>) {
+            if (deltas_.contains(basic_block)) {
+                return deltas_.get(basic_block);
+            }
+        }
+        auto it = joined_.find(basic_block);
+        return it != joined_.end() ? it->second : AbstractState{};
+    }
+
+private:
+    /// Joins the states of nodes, releasing each node after its function if nodes is not const.
+    template <typename NodeMap> void join(NodeMap& nodes) {
+        std::unordered_map<llvm::Function const*, std::vector<decltype(nodes.begin())>> functions;
+        for (auto it = nodes.begin(); it != nodes.end(); ++it) {
+            // A node without a block was never registered, and has no state or function
+            if (!it->second.basic_block) continue;
+            fixpoint_ &= not it->second.update_scheduled;
+            functions[it->second.function()].push_back(it);
+        }
+
+        for (auto const& [function, function_nodes]: functions) {
+            std::unordered_map<llvm::BasicBlock const*, AbstractState> states;
+            for (auto it: function_nodes) {
+                states[it->second.basic_block].merge(Merge_op::UPPER_BOUND, it->second.state);
+                if constexpr (!std::is_const_v<NodeMap>) {
+                    nodes.erase(it);
+                }
+            }
+            if constexpr (has_delta<AbstractState>) {
+                if (DeltaStorage) {
+                    deltas_.add(*function, states);
+                    continue;
+                }
+            }
+            for (auto& [basic_block, state]: states) {
+                joined_.emplace(basic_block, std::move(state));
+            }
+        }
+
+        if constexpr (has_delta<AbstractState>) {
+            if (DeltaStorage) {
+                dbgs(1) << "Stored " << deltas_.snapshotCount() << " states as snapshots and "
+                        << deltas_.deltaCount() << " as deltas\n";
+            }
+        }
+    }
+
+    std::unordered_map<llvm::BasicBlock const*, AbstractState> joined_;
+    DeltaStates<AbstractState> deltas_;
+    bool fixpoint_ = true;
+};
+
+/// What an analysis of the registry found out about a module (see registry.h).
+struct AnalysisStatistics {
+    /// Functions that were reached
+    size_t functions = 0;
+    /// Basic blocks that were reached
+    size_t blocks = 0;
+    /// Basic blocks in all of their contexts
+    size_t nodes = 0;
+    /// Whether the iteration finished. Otherwise, the states are not sound.
+    bool fixpoint = true;
+};
+
 class AbstractInterpretationPass: public llvm::ModulePass {
 public:
     AbstractInterpretationPass(): llvm::ModulePass{ID} {}
@@ -15,4 +143,25 @@ public:
     virtual void getAnalysisUsage(llvm::AnalysisUsage &Info) const;
 };
 
+/// The fixpoint of a module for the new pass manager. The result stays cached in the analysis
+/// manager until a pass does not preserve it.
+class AbstractInterpretationAnalysis: public llvm::AnalysisInfoMixin<AbstractInterpretationAnalysis> {
+    friend llvm::AnalysisInfoMixin<AbstractInterpretationAnalysis>;
+    static llvm::AnalysisKey Key;
+
+public:
+    using AbstractState = ConstantFolding<IntegerDomain>;
+    using Result = std::unordered_map<NodeKey, Node<AbstractState>>;
+
+    Result run(llvm::Module& M, llvm::ModuleAnalysisManager& MAM);
+};
+
+/// Rewrites the module with the constants and unreachable blocks found by
+/// AbstractInterpretationAnalysis. This erases instructions, so the result is invalidated if
+/// anything changed.
+class AbstractInterpretationTransformPass: public llvm::PassInfoMixin<AbstractInterpretationTransformPass> {
+public:
+    llvm::PreservedAnalyses run(llvm::Module& M, llvm::ModuleAnalysisManager& MAM);
+};
+
 } /* end of namespace pcpo */
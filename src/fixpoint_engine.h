@@ -0,0 +1,827 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <llvm/ADT/PostOrderIterator.h>
+#include <llvm/Analysis/CFG.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "fixpoint.h"
+#include "general.h"
+#include "global.h"
+#include "hash_utils.h"
+#include "liveness.h"
+#include "parallel.h"
+
+// The fixpoint engine. Its templates are instantiated in fixpoint.cpp for the
+// domains of the transformations, and in a translation unit of their own for
+// each domain and engine of the registry (see registry.h), so that they are
+// compiled in parallel.
+
+namespace pcpo {
+
+// Options of the pass that the engine reads, defined in fixpoint.cpp
+extern llvm::cl::opt<std::string> OutputFilename;
+extern llvm::cl::opt<unsigned> ContextDepth;
+extern llvm::cl::opt<bool> AdaptiveContexts;
+extern llvm::cl::opt<unsigned> ContextBudget;
+extern llvm::cl::opt<unsigned> Threads;
+extern llvm::cl::opt<bool> ExtendedBlocks;
+
+// MARK: - To String
+
+template <typename T>
+T &operator<<(T &os, llvm::BasicBlock const &basic_block) {
+  os << "%";
+  if (llvm::Function const *f = basic_block.getParent()) {
+    os << f->getName() << ".";
+  }
+  return os << basic_block.getName();
+}
+
+template <typename T> T &operator<<(T &os, Callstring const &callstring) {
+  for (auto call : callstring) {
+    os << std::string(call->getName());
+    if (call != callstring.back()) {
+      os << " -> ";
+    }
+  }
+  return os;
+}
+
+template <typename T> T &operator<<(T &os, NodeKey const &key) {
+  return os << "[" << *key.second << "," << key.first << "]";
+}
+
+/// Callstring of function when called from callstring, which keeps the
+/// max_length most recent calls of the caller's callstring.
+Callstring callstring_for(llvm::Function const *function,
+                          Callstring const &callstring, int max_length);
+
+/// Creates the nodes of function in the context new_callstring, whose last
+/// element is function.
+template <typename AbstractState>
+std::vector<Node<AbstractState> *>
+register_function(
+    llvm::Function const *function, Callstring const &new_callstring,
+    std::unordered_map<pcpo::NodeKey, Node<AbstractState>> &nodes) {
+  std::vector<Node<AbstractState> *> inserted_nodes;
+
+  for (llvm::po_iterator<llvm::BasicBlock const *>
+           I = llvm::po_begin(&function->getEntryBlock()),
+           IE = llvm::po_end(&function->getEntryBlock());
+       I != IE; ++I) {
+
+    llvm::BasicBlock const *basic_block = *I;
+
+    dbgs(1) << "  Found basic block: " << basic_block->getName() << '\n';
+    NodeKey key = {new_callstring, basic_block};
+    Node<AbstractState> node = {basic_block, new_callstring};
+    if (node.isEntry()) {
+      node.state = AbstractState{*node.function()};
+    }
+    inserted_nodes.push_back(&nodes[key]);
+    nodes[key] = node;
+  }
+  return inserted_nodes;
+}
+
+/// AbstractState::Cache, or NoCache. A domain that keeps data for all of its
+/// states declares a Cache with a nested Scope (see LinearSubspace::Cache).
+/// executeFixpointAlgorithm owns one cache per run, and every thread of the run
+/// holds a Scope of it while it analyzes.
+struct NoCache {
+  struct Scope {
+    explicit Scope(NoCache &) {}
+  };
+};
+template <typename AbstractState, typename = void> struct CacheOf {
+  using type = NoCache;
+};
+template <typename AbstractState>
+struct CacheOf<AbstractState, std::void_t<typename AbstractState::Cache>> {
+  using type = typename AbstractState::Cache;
+};
+
+/// Removes the nodes of the contexts callstrings, whose last element is their
+/// function. The blocks that call one of these functions are evaluated again
+/// in all contexts, so that their calls move to the contexts that replace the
+/// removed ones.
+template <typename AbstractState>
+void remove_contexts(std::vector<Callstring> const &callstrings,
+                     std::unordered_map<NodeKey, Node<AbstractState>> &nodes,
+                     std::vector<Node<AbstractState> *> &worklist) {
+  std::unordered_set<Node<AbstractState> const *> removed;
+  std::unordered_set<llvm::Function const *> functions;
+  for (Callstring const &callstring : callstrings) {
+    functions.insert(callstring.back());
+    for (llvm::BasicBlock const &basic_block : *callstring.back()) {
+      auto it = nodes.find({callstring, &basic_block});
+      if (it != nodes.end()) {
+        removed.insert(&it->second);
+      }
+    }
+  }
+  worklist.erase(std::remove_if(worklist.begin(), worklist.end(),
+                                [&removed](Node<AbstractState> *node) {
+                                  return removed.count(node) != 0;
+                                }),
+                 worklist.end());
+
+  auto calls_removed = [&functions](llvm::BasicBlock const &basic_block) {
+    for (llvm::Instruction const &inst : basic_block) {
+      auto call = llvm::dyn_cast<llvm::CallInst>(&inst);
+      if (call && functions.count(call->getCalledFunction())) {
+        return true;
+      }
+    }
+    return false;
+  };
+  for (auto it = nodes.begin(); it != nodes.end();) {
+    Node<AbstractState> &node = it->second;
+    if (removed.count(&node)) {
+      dbgs(3) << "    Removing " << it->first << '\n';
+      it = nodes.erase(it);
+      continue;
+    }
+    if (!node.update_scheduled && calls_removed(*node.basic_block)) {
+      node.update_scheduled = true;
+      worklist.push_back(&node);
+    }
+    ++it;
+  }
+}
+
+// MARK: - Contexts
+
+/// Decides in which context a called function is analyzed. By default, the
+/// callstring of a function consists of its depth most recent callers (see
+/// callstring_for).
+///
+/// The adaptive policy starts with a single context per function. Once two of
+/// its call sites pass different entry states, the function is analyzed with
+/// the shortest callstrings that tell the two apart, up to depth. When a
+/// function has more than budget contexts, it is collapsed into a single one
+/// for the rest of the analysis. Either way, the contexts the function had
+/// before are replaced, and the engine removes their nodes (see
+/// remove_contexts).
+template <typename AbstractState> class ContextPolicy {
+public:
+  ContextPolicy(int depth, bool adaptive, unsigned budget)
+      : max_depth{depth}, adaptive{adaptive}, budget{budget} {}
+
+  /// Callstring for callee, when it is called by call in caller_callstring
+  /// with the entry state entry. The contexts of callee that are no longer
+  /// used are added to replaced.
+  Callstring contextFor(llvm::Function const *callee,
+                        Callstring const &caller_callstring,
+                        llvm::CallInst const *call,
+                        AbstractState const &entry,
+                        std::vector<Callstring> &replaced) {
+    if (!adaptive) {
+      return callstring_for(callee, caller_callstring, max_depth);
+    }
+
+    Contexts &contexts = functions[callee];
+    if (!contexts.collapsed) {
+      CallSite site = {caller_callstring, call};
+      contexts.sites.insert(site);
+      if (contexts.latest_site && *contexts.latest_site != site &&
+          !equal(entry, contexts.latest_entry)) {
+        Callstring const &other = std::get<0>(*contexts.latest_site);
+        for (int depth = contexts.depth + 1; depth <= max_depth; ++depth) {
+          if (callstring_for(callee, caller_callstring, depth) !=
+              callstring_for(callee, other, depth)) {
+            dbgs(3) << "    Analyzing " << callee->getName()
+                    << " with depth " << depth << '\n';
+            contexts.depth = depth;
+            replace(callee, contexts, replaced);
+            break;
+          }
+        }
+      }
+      contexts.latest_site = site;
+      contexts.latest_entry = entry;
+    }
+
+    Callstring callstring =
+        callstring_for(callee, caller_callstring, contexts.depth);
+    if (!contexts.collapsed) {
+      contexts.callstrings.insert(callstring);
+      if (contexts.callstrings.size() > budget) {
+        dbgs(3) << "    " << callee->getName() << " exceeds the budget of "
+                << budget << " contexts, collapsing\n";
+        contexts.collapsed = true;
+        contexts.depth = 0;
+        replace(callee, contexts, replaced);
+        contexts.sites.clear();
+        contexts.latest_site.reset();
+        contexts.latest_entry = {};
+        callstring = callstring_for(callee, caller_callstring, 0);
+      }
+    }
+    return callstring;
+  }
+
+private:
+  using CallSite = std::tuple<Callstring, llvm::CallInst const *>;
+
+  struct Contexts {
+    int depth = 0;
+    bool collapsed = false;
+    std::unordered_set<CallSite> sites;
+    /// The call site that called last, with its entry state. Only one state
+    /// is kept per function, which the next call site is compared to.
+    std::optional<CallSite> latest_site;
+    AbstractState latest_entry;
+    std::unordered_set<Callstring> callstrings;
+  };
+
+  /// Replaces the callstrings of contexts by those its call sites have at the
+  /// current depth. The ones that are gone are added to replaced.
+  static void replace(llvm::Function const *callee, Contexts &contexts,
+                      std::vector<Callstring> &replaced) {
+    std::unordered_set<Callstring> callstrings;
+    for (auto const &[caller_callstring, call] : contexts.sites) {
+      callstrings.insert(
+          callstring_for(callee, caller_callstring, contexts.depth));
+    }
+    for (Callstring const &callstring : contexts.callstrings) {
+      if (!callstrings.count(callstring)) {
+        replaced.push_back(callstring);
+      }
+    }
+    contexts.callstrings = std::move(callstrings);
+  }
+
+  static bool equal(AbstractState const &lhs, AbstractState const &rhs) {
+    // Equal states are upper bounds of each other
+    AbstractState lhs_joined = lhs;
+    AbstractState rhs_joined = rhs;
+    return !lhs_joined.merge(Merge_op::UPPER_BOUND, rhs) &&
+           !rhs_joined.merge(Merge_op::UPPER_BOUND, lhs);
+  }
+
+  int max_depth;
+  bool adaptive;
+  unsigned budget;
+  std::unordered_map<llvm::Function const *, Contexts> functions;
+};
+
+template <typename AbstractState>
+void add_to_worklist(std::vector<Node<AbstractState> *> &nodes,
+                     std::vector<Node<AbstractState> *> &worklist) {
+  for (Node<AbstractState> *node : nodes) {
+    node->update_scheduled = true;
+    worklist.push_back(node);
+  }
+}
+
+// MARK: - Entry points
+
+/// Functions that are analyzed without a caller. This is main, or in library
+/// mode every externally visible function defined in the module. Modules
+/// without a main are always analyzed as a library.
+std::vector<llvm::Function const *> entry_points(llvm::Module const &M);
+
+/// Reads the bodies of all functions that the analysis may reach from roots,
+/// if the module was loaded lazily. This has to happen before the entry points
+/// are analyzed in parallel, as reading a body changes the LLVMContext.
+void materialize_reachable(std::vector<llvm::Function const *> const &roots);
+
+/// Partitions the entry points into groups that can be analyzed
+/// independently of each other. Callstrings only keep the most recent callers,
+/// so the contexts of a callee may be shared between all entry points that
+/// reach it. Entry points that reach a common function are therefore analyzed
+/// together, and reuse the results of that function.
+std::vector<std::vector<llvm::Function const *>>
+independent_groups(std::vector<llvm::Function const *> const &roots);
+
+// MARK: - Fixpoint
+
+// Run the simple fixpoint algorithm with callstrings, starting at the given
+// entry points. Their arguments are assumed to be anything. AbstractState
+// should implement the interface documented in AbstractStateDummy (no need to
+// subclass or any of that, just implement the methods with the right
+// signatures and take care to fulfil the contracts outlines above). Note that a
+// lot of this code is duplicated in executeFixpointAlgorithmWidening in
+// fixpoint_widening.h, so if you fix any bugs in here, they probably should
+// be fixed there as well.
+//  Tip: Look at a diff of fixpoint_engine.h and fixpoint_widening.h with a
+//  visual diff tool (I recommend Meld.)
+template <typename AbstractState, int iterations_max, Merge_op::Type merge_op>
+void analyzeEntryPoints(
+    std::vector<llvm::Function const *> const &roots,
+    ContextPolicy<AbstractState> policy,
+    std::unordered_map<NodeKey, Node<AbstractState>> &nodes) {
+  using Node = Node<AbstractState>;
+
+  std::vector<Node *> worklist;
+
+  // TODO: Check what this does for release clang, probably write out a warning
+  dbgs(1) << "Initialising fixpoint algorithm, collecting basic blocks\n";
+
+  // Register basic blocks of the entry points
+  for (llvm::Function const *root : roots) {
+    auto root_basic_blocks = register_function(root, {root}, nodes);
+    add_to_worklist(root_basic_blocks, worklist);
+  }
+
+  // States only keep the values that are still needed at the end of their
+  // block, which also drops the values of the caller from a callee's states
+  std::unordered_map<llvm::Function const *, Liveness> liveness;
+  auto project = [&liveness](AbstractState &state,
+                             llvm::BasicBlock const *basic_block) {
+    llvm::Function const *function = basic_block->getParent();
+    Liveness const &live =
+        liveness.try_emplace(function, *function).first->second;
+    state.project([&live, basic_block](llvm::Value const *value) {
+      return live.isNeeded(basic_block, value);
+    });
+  };
+
+  // With widening, only the targets of back edges and the function entries
+  // are widened, which is enough for termination. They are joined for the
+  // first few changes, so that short chains stay precise.
+  constexpr int widen_after = 2;
+  std::unordered_set<llvm::BasicBlock const *> widening_points;
+  if (merge_op == Merge_op::WIDEN) {
+    for (llvm::Function const &function : *roots.front()->getParent()) {
+      // Bodies that were never read are empty
+      if (function.empty()) {
+        continue;
+      }
+      llvm::SmallVector<
+          std::pair<llvm::BasicBlock const *, llvm::BasicBlock const *>, 8>
+          edges;
+      llvm::FindFunctionBackedges(function, edges);
+      widening_points.insert(&function.getEntryBlock());
+      for (auto const &edge : edges) {
+        widening_points.insert(edge.second);
+      }
+    }
+  }
+  // Once widening has reached a fixpoint, every node is evaluated again,
+  // narrowing its state. Each step keeps the states sound, so this phase may
+  // stop early. Narrowing need not terminate on its own, so a node is only
+  // narrowed a few times. The phase has a budget of its own, enough to
+  // evaluate every node that often, which does not count against the
+  // iterations_max of widening.
+  constexpr int narrow_max = 2;
+  int iterations_limit = iterations_max;
+  bool narrowing = false;
+  auto merge_for = [&widening_points, &narrowing](Node const &node) {
+    if (narrowing) {
+      return Merge_op::NARROW;
+    }
+    if (merge_op == Merge_op::WIDEN &&
+        (node.change_count < widen_after ||
+         !widening_points.count(node.basic_block))) {
+      return Merge_op::UPPER_BOUND;
+    }
+    return merge_op;
+  };
+
+  dbgs(1) << "\nWorklist initialised with " << worklist.size()
+          << (worklist.size() != 1 ? " entries" : " entry")
+          << ". Starting fixpoint iteration...\n";
+
+  // With -pain-extended-blocks, a block with a single predecessor continues
+  // its extended basic block right away instead of going through the
+  // worklist. Its incoming state is the predecessor's, refined by the branch.
+  Node *chained = nullptr;
+
+  // Blocks that are not reachable from the entry of their function have no
+  // node (see register_function), so as predecessors they contribute bottom.
+  AbstractState const unreached;
+  auto state_at = [&nodes, &unreached](Callstring const &callstring,
+                                       llvm::BasicBlock const *basic_block)
+      -> AbstractState const & {
+    auto it = nodes.find({callstring, basic_block});
+    return it != nodes.end() ? it->second.state : unreached;
+  };
+
+  // Contexts that the policy replaced. Their nodes are removed before the next
+  // node is evaluated, as the current one may belong to them.
+  std::vector<Callstring> replaced;
+  auto remove_replaced = [&]() {
+    if (chained) {
+      worklist.push_back(chained);
+      chained = nullptr;
+    }
+    remove_contexts(replaced, nodes, worklist);
+    replaced.clear();
+  };
+
+  for (int iter = 0; iter < iterations_limit; ++iter) {
+    if (!replaced.empty()) {
+      remove_replaced();
+    }
+    if (!chained && worklist.empty()) {
+      if (merge_op != Merge_op::WIDEN || narrowing) {
+        break;
+      }
+      dbgs(1) << "\nWidening is stable, starting to narrow\n";
+      narrowing = true;
+      iterations_limit = iter + int(nodes.size()) * (narrow_max + 1);
+      for (auto &[key, node] : nodes) {
+        if (!node.basic_block) {
+          continue;
+        }
+        worklist.push_back(&node);
+        node.update_scheduled = true;
+        node.change_count = 0;
+      }
+    }
+
+    if (!chained) {
+      chained = worklist.back();
+      worklist.pop_back();
+    }
+    Node &node = *chained;
+    chained = nullptr;
+    node.update_scheduled = false;
+
+    dbgs(1) << "\nIteration " << iter << ", considering basic block "
+            << *node.basic_block << " with callstring " << node.callstring
+            << '\n';
+
+    AbstractState state_new; // Set to bottom
+    std::vector<AbstractState> predecessors;
+    llvm::BasicBlock const *single_pred =
+        ExtendedBlocks && pred_size(node.basic_block) == 1
+            ? *llvm::pred_begin(node.basic_block)
+            : nullptr;
+
+    if (single_pred) {
+      dbgs(3) << "    Continuing from basic block " << *single_pred << '\n';
+
+      // The state is copied once, rather than joined into bottom
+      state_new = state_at(node.callstring, single_pred);
+      state_new.branch(*single_pred, *node.basic_block);
+      if (llvm::isa<llvm::PHINode>(node.basic_block->front())) {
+        predecessors.push_back(state_new);
+      }
+    } else if (node.isEntry()) {
+      dbgs(1) << "  Merging function parameters, is entry block\n";
+
+      // if it is the entry node, then its state should be top
+      state_new.merge(merge_op, node.state);
+      state_new.isBottom = false;
+    }
+
+    if (!single_pred) {
+      dbgs(1) << "  Merge of " << pred_size(node.basic_block)
+              << (pred_size(node.basic_block) != 1 ? " predecessors.\n"
+                                                   : " predecessor.\n");
+
+      // Collect the predecessors
+      for (llvm::BasicBlock const *basic_block :
+           llvm::predecessors(node.basic_block)) {
+        dbgs(3) << "    Merging basic block " << *basic_block << '\n';
+
+        AbstractState state_branched{state_at(node.callstring, basic_block)};
+        state_branched.branch(*basic_block, *node.basic_block);
+        state_new.merge(narrowing ? Merge_op::UPPER_BOUND : merge_op,
+                        state_branched);
+        predecessors.push_back(state_branched);
+      }
+    }
+
+    dbgs(2) << "  Relevant incoming state is:\n";
+    state_new.printIncoming(*node.basic_block, dbgs(2), 4);
+
+    // Apply the basic block
+    dbgs(3) << "  Applying basic block\n";
+
+    if (state_new.isBottom) {
+      dbgs(3) << "    Basic block is unreachable, everything is bottom\n";
+    } else {
+      // Applies all instrucions of a basic block
+      for (llvm::Instruction const &inst : *node.basic_block) {
+
+        // Handles return instructions
+        if (llvm::isa<llvm::ReturnInst>(&inst)) {
+          state_new.applyReturnInst(inst);
+        }
+
+        // If the result of the instruction is not used, there is no reason to
+        // compute it. (There are no side-effects in LLVM IR. (I hope.))
+        // if (inst.use_empty()) {
+        //   // Except for call instructions, we still want to get that
+        //   information if (not isa<CallInst>(&inst)) {
+        //     dbgs(3) << "    Empty use of instruction, " <<
+        //     inst.getOpcodeName()
+        //             << " skipping...\n";
+        //     continue;
+        //   }
+        // }
+
+        // Handles merging points
+        if (llvm::isa<llvm::PHINode>(&inst)) {
+          state_new.applyPHINode(*node.basic_block, predecessors, inst);
+
+          // Handles function calls
+        } else if (llvm::CallInst const *call =
+                       llvm::dyn_cast<llvm::CallInst>(&inst)) {
+
+          // Checks if an input parameter for the callee is bottom. If so,
+          // then skip the calculation of the call instruction for now
+          if (state_new.checkOperandsForBottom(inst))
+            continue;
+
+          llvm::Function const *callee_func = call->getCalledFunction();
+
+          // Functions such as printf, and indirect calls, are not analyzed.
+          // Their result can be anything.
+          if (!callee_func || callee_func->empty()) {
+            dbgs(3) << "    Call is external, skipping...\n";
+            state_new.applyDefault(inst);
+            continue;
+          }
+
+          AbstractState state_update{callee_func, state_new, call};
+          project(state_update, &callee_func->getEntryBlock());
+          Callstring new_callstring = policy.contextFor(
+              callee_func, node.callstring, call, state_update, replaced);
+
+          NodeKey callee_element = {new_callstring,
+                                    &callee_func->getEntryBlock()};
+          std::vector<Node *> callee_basic_blocks;
+          bool changed;
+
+          // Checks whether a node with key [%callee entry block, %caller basic
+          // block], i.e. an entry block with callstring of caller basic block,
+          // exists. If not, all nodes with their corrosponding keys are
+          // initilized for the callee function.
+          if (nodes.find(callee_element) == nodes.end()) {
+            // Check if abstract_state of call.bb is bottom or not
+            dbgs(3) << "    No information regarding function call %"
+                    << call->getCalledFunction()->getName() << "\n";
+
+            callee_basic_blocks =
+                register_function(callee_func, new_callstring, nodes);
+
+            nodes[callee_element].state = state_update;
+            changed = true;
+          } else {
+            // update callee
+            AbstractState before = nodes[callee_element].state;
+
+            // Collect all basic blocks of callee_func
+            for (llvm::po_iterator<llvm::BasicBlock const *>
+                     I = llvm::po_begin(&callee_func->getEntryBlock()),
+                     IE = llvm::po_end(&callee_func->getEntryBlock());
+                 I != IE; ++I) {
+              llvm::BasicBlock const *basic_block = *I;
+              NodeKey key = {new_callstring, basic_block};
+              callee_basic_blocks.push_back(&nodes[key]);
+            }
+
+            // The entry state joins all call sites, so it must not be
+            // narrowed by a single one of them
+            Node &callee_entry = nodes[callee_element];
+            changed = callee_entry.state.merge(
+                narrowing ? Merge_op::UPPER_BOUND : merge_for(callee_entry),
+                state_update);
+          }
+
+          // The callee may return from several blocks, so the result is the
+          // join over all of them. Without any, the last block is used.
+          std::vector<llvm::BasicBlock const *> end_blocks;
+          for (llvm::BasicBlock const &callee_bb : *callee_func) {
+            if (llvm::isa<llvm::ReturnInst>(callee_bb.getTerminator())) {
+              end_blocks.push_back(&callee_bb);
+            }
+          }
+          if (end_blocks.empty()) {
+            end_blocks.push_back(&*std::prev(callee_func->end()));
+          }
+          AbstractState state_returned = state_new;
+          for (llvm::BasicBlock const *end_block : end_blocks) {
+            AbstractState state_call = state_new;
+            state_call.applyCallInst(inst, end_block,
+                                     state_at(new_callstring, end_block));
+            if (end_block == end_blocks.front()) {
+              state_returned = std::move(state_call);
+            } else {
+              state_returned.merge(Merge_op::UPPER_BOUND, state_call);
+            }
+          }
+          state_new = std::move(state_returned);
+
+          // If input parameters have changed, we want to interpret the function
+          // once again and reevaluate the nodes of possible callers.
+          if (changed) {
+            for (auto &[key, value] : nodes) {
+              if (key.second == node.basic_block and
+                  not value.update_scheduled) {
+                dbgs(3) << "      Adding possible caller " << key
+                        << " to worklist\n";
+                worklist.push_back(&value);
+                value.update_scheduled = true;
+              }
+            }
+
+            // Checks if the key of the callee functions entry node is already
+            // on the worklist, this is necessary for recursions.
+            for (Node *elem : callee_basic_blocks) {
+              if (!elem->update_scheduled) {
+                worklist.push_back(elem);
+                elem->update_scheduled = true;
+
+                dbgs(3) << "      Adding callee " << *elem->basic_block << " "
+                        << elem->callstring << " to worklist\n";
+              } else {
+                dbgs(3)
+                    << "      Callee already on worklist, nothing to add...\n";
+              }
+            }
+          }
+        } else {
+          if (state_new.checkOperandsForBottom(inst))
+            continue;
+          state_new.applyDefault(inst);
+        }
+      }
+    }
+
+    // Merge the state back into the node
+    dbgs(3) << "  Merging with stored state\n";
+    project(state_new, node.basic_block);
+    bool changed = !(narrowing && node.change_count >= narrow_max) &&
+                   node.state.merge(merge_for(node), state_new);
+    node.change_count += changed;
+
+    dbgs(2) << "  Outgoing state " << (changed ? "changed" : "didn't change")
+            << ":\n";
+    state_new.printOutgoing(*node.basic_block, dbgs(2), 4);
+
+    // No changes, so no need to do anything else
+    if (not changed)
+      continue;
+
+    dbgs(2) << "  State changed, notifying " << succ_size(node.basic_block)
+            << (succ_size(node.basic_block) != 1 ? " successors\n"
+                                                 : " successor\n");
+
+    // Something changed and we will need to update the successors
+    for (llvm::BasicBlock const *succ_bb : llvm::successors(node.basic_block)) {
+      NodeKey succ_key = {{node.callstring}, succ_bb};
+      Node &succ = nodes[succ_key];
+      if (not succ.update_scheduled) {
+        succ.update_scheduled = true;
+        if (ExtendedBlocks && !chained && pred_size(succ_bb) == 1) {
+          chained = &succ;
+          dbgs(3) << "    Continuing with " << succ_key << '\n';
+          continue;
+        }
+        worklist.push_back(&succ);
+
+        dbgs(3) << "    Adding " << succ_key << " to worklist\n";
+      }
+    }
+  }
+
+  if (!replaced.empty()) {
+    remove_replaced();
+  }
+  if (chained) {
+    worklist.push_back(chained);
+  }
+  if (!worklist.empty() && narrowing) {
+    dbgs(1) << "Narrowing terminated due to exceeding loop count.\n";
+    for (Node *node : worklist) {
+      node->update_scheduled = false;
+    }
+    worklist.clear();
+  } else if (!worklist.empty()) {
+    dbgs(0) << "Iteration terminated due to exceeding loop count.\n";
+  }
+}
+
+// Analyze main, or every externally visible function in library mode (see
+// entry_points). Entry points that do not share any nodes are analyzed in
+// parallel, if -pain-threads allows it. The results of all of them are
+// combined. The contexts of functions are chosen according to
+// -pain-context-depth and -pain-adaptive-contexts (see ContextPolicy).
+template <typename AbstractState, int iterations_max = 1000,
+          Merge_op::Type merge_op = Merge_op::UPPER_BOUND>
+std::unordered_map<NodeKey, Node<AbstractState>>
+executeFixpointAlgorithm(llvm::Module const &M) {
+  using Node = Node<AbstractState>;
+
+  std::vector<llvm::Function const *> roots = entry_points(M);
+  materialize_reachable(roots);
+  std::vector<std::vector<llvm::Function const *>> groups =
+      independent_groups(roots);
+  dbgs(1) << "Analyzing " << groups.size()
+          << (groups.size() != 1 ? " independent groups" : " independent group")
+          << " of entry points\n";
+
+  // Dropped at the end of the run, as the transformations change the IR
+  using Cache = typename CacheOf<AbstractState>::type;
+  Cache cache;
+
+  std::vector<std::unordered_map<NodeKey, Node>> results(groups.size());
+  run_parallel(groups.size(), Threads, [&](size_t i) {
+    typename Cache::Scope scope{cache};
+    ContextPolicy<AbstractState> policy{int(ContextDepth), AdaptiveContexts,
+                                        ContextBudget};
+    analyzeEntryPoints<AbstractState, iterations_max, merge_op>(
+        groups[i], policy, results[i]);
+  });
+
+  // The groups reach disjoint sets of functions, so their keys are distinct
+  std::unordered_map<NodeKey, Node> nodes;
+  for (auto &result : results) {
+    nodes.merge(result);
+  }
+
+  std::ofstream Res(OutputFilename.c_str());
+  unsigned int y = 0;
+  if (Res.good()) {
+    dbgs(0) << "Output filename: " << OutputFilename.c_str();
+
+    std::error_code ErrInfo;
+    llvm::raw_fd_ostream Result(OutputFilename.c_str(), ErrInfo,
+                                llvm::sys::fs::F_None);
+    llvm::StringRef sofar("");
+    Result << "{\n";
+    for (auto const &[key, node] : nodes) {
+      llvm::StringRef name = (*node.basic_block).getParent()->getName();
+
+      if (!sofar.equals(name)) {
+        if (sofar.size() != 0)
+          Result << "},\n";
+        Result << "\"" << name << "\":{\n";
+        sofar = name;
+      }
+      Result << "  \"" << (*node.basic_block).getName() << "\""
+             << ":{\n";
+      node.state.printOutgoing(*node.basic_block, Result, 4);
+      Result << "  }";
+      if (y++ != nodes.size() - 1)
+        Result << ",";
+      Result << "\n";
+    }
+    Result << "}}\n";
+    Result.flush();
+  }
+
+  // Output the final result
+  dbgs(0) << "\nFinal result:\n";
+  for (auto const &[key, node] : nodes) {
+    dbgs(0) << key << ":\n";
+    node.state.printOutgoing(*node.basic_block, dbgs(0), 2);
+  }
+
+  return nodes;
+}
+
+// MARK: - Batch analysis
+
+// Analyze M and print the outgoing state of every reached block, joined over
+// all contexts. This is what the analyses in the registry run (see
+// registry.h).
+template <typename AbstractState, Merge_op::Type merge_op>
+void analyze_with(llvm::Module const &M, llvm::raw_ostream &out,
+                  AnalysisStatistics &statistics) {
+  auto nodes = executeFixpointAlgorithm<AbstractState, 1000, merge_op>(M);
+  statistics.nodes = nodes.size();
+  BlockStates<AbstractState> states{std::move(nodes)};
+  statistics.fixpoint = states.isFixpoint();
+
+  for (llvm::Function const &function : M) {
+    if (function.empty() || !states.reached(&function.getEntryBlock())) {
+      continue;
+    }
+    ++statistics.functions;
+    out << function.getName() << ":\n";
+    for (llvm::BasicBlock const &basic_block : function) {
+      if (!states.reached(&basic_block)) {
+        continue;
+      }
+      ++statistics.blocks;
+      out << "  ";
+      basic_block.printAsOperand(out, false);
+      out << ":\n";
+      states.joined(&basic_block).printOutgoing(basic_block, out, 4);
+    }
+  }
+}
+
+} // namespace pcpo
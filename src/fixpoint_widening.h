@@ -1,3 +1,5 @@
+#pragma once
+
 #include <unordered_map>
 #include <vector>
 
@@ -17,9 +19,9 @@ namespace pcpo {
 // documented in AbstractStateDummy (no need to subclass or any of that, just implement the methods
 // with the right signatures and take care to fulfil the contracts outlines above).
 // Note that a lot of this code is duplicated in executeFixpointAlgorithmWidening in
-// fixpoint_widening.cpp, so if you fix any bugs in here, they probably should be fixed there as
+// fixpoint_widening.h, so if you fix any bugs in here, they probably should be fixed there as
 // well.
-//  Tip: Look at a diff of fixpoint.cpp and fixpoint_widening.cpp with a visual diff tool (I
+//  Tip: Look at a diff of fixpoint_engine.h and fixpoint_widening.h with a visual diff tool (I
 // recommend Meld.)
 template <typename AbstractState>
 void executeFixpointAlgorithmWidening(llvm::Module& M) {
@@ -41,6 +43,7 @@ void executeFixpointAlgorithmWidening(llvm::Module& M) {
 
 		bool should_widen = false; // Whether we want to widen at this node
 		int change_count = 0; // How often has node changed during iterations
+		bool visited = false; // Whether the node has been evaluated before
     };
 
     std::unordered_map<bb_key, Node> nodes;
@@ -125,8 +128,8 @@ void executeFixpointAlgorithmWidening(llvm::Module& M) {
             dbgs(1) << "  Merging function parameters, is entry block\n";
 
             // if it is the entry node, then its state should be top
-            state_new.isBottom = false;
             state_new.merge(Merge_op::UPPER_BOUND, node.state);
+            state_new.isBottom = false;
         }
 
         dbgs(1) << "  Merge of " << llvm::pred_size(node.bb)
@@ -270,10 +273,13 @@ void executeFixpointAlgorithmWidening(llvm::Module& M) {
 
         dbgs(2) << "  Outgoing state is:\n"; state_new.printOutgoing(*node.bb, dbgs(2), 4);
 
-        // No changes, so no need to do anything else
-        if (not changed) continue;
+        // No changes, so no need to do anything else. The first evaluation always has to notify the
+        // successors though, as the stored state of entry blocks is not bottom initially.
+        bool first_visit = not node.visited;
+        node.visited = true;
+        if (not changed and not first_visit) continue;
 
-        ++node.change_count;
+        node.change_count += changed;
 
         dbgs(2) << "  Node change count:";
         dbgs(2) << node.change_count << "\n";
@@ -16,16 +16,24 @@ extern int debug_level;
 // This is the initial setting
 #define DEBUG_LEVEL 4
 
+// If set, the debug output of the current thread is written here instead of stderr. Threads that
+// analyze parts of a module in parallel buffer their output, so that it does not interleave.
+extern thread_local llvm::raw_ostream* debug_stream;
+
 // This returns either a stream to stderr or to nowhere, depending on whether we are currently
 // outputting that level.
 inline llvm::raw_ostream& dbgs(int level) {
-    if (level <= DEBUG_LEVEL) {
-        return llvm::errs();
+    if (level <= debug_level) {
+        return debug_stream ? *debug_stream : llvm::errs();
     } else {
         return llvm::nulls();
     }
 }
 
+// Stream for the reports of the transformations, written to the file given with -pain-report. If
+// there is none, this goes nowhere.
+llvm::raw_ostream& report();
+
 namespace Merge_op {
 
 // see the documentation of AbstractStateDummy::merge for an explanation of what these mean
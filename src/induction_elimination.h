@@ -0,0 +1,252 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Instructions.h>
+
+#include "global.h"
+#include "linear_subspace.h"
+
+namespace pcpo {
+
+/// Affine relation analysis whose results are used to remove redundant
+/// induction variables. If a header phi p always equals a * q + b, where q is
+/// the primary induction variable of the loop, i.e. the one with the smallest
+/// step, p is computed from q and its recurrence is deleted. The relations of
+/// the analysis are rechecked on the recurrences before anything changes:
+/// both phis need constant steps with step_p = a * step_q, and their initial
+/// values have to satisfy the relation. The relation then holds modulo the bit
+/// width in every iteration.
+class InductionVariableElimination : public LinearSubspace {
+public:
+  using LinearSubspace::LinearSubspace;
+
+  void applyPHINode(llvm::BasicBlock const &bb,
+                    std::vector<InductionVariableElimination> const &pred_values,
+                    llvm::Instruction const &inst) {
+    std::vector<LinearSubspace> preds(pred_values.begin(), pred_values.end());
+    LinearSubspace::applyPHINode(bb, preds, inst);
+  }
+
+  /// Eliminates the redundant induction variables of function, where
+  /// state_of(bb) is the outgoing state of bb, joined over all contexts.
+  /// Returns whether the function changed.
+  template <typename StateOf>
+  static bool transformFunction(llvm::Function &function,
+                                StateOf const &state_of) {
+    llvm::DominatorTree dominators{function};
+    llvm::LoopInfo loops{dominators};
+    bool hasChanged = false;
+
+    for (llvm::Loop *loop : loops.getLoopsInPreorder()) {
+      llvm::BasicBlock *header = loop->getHeader();
+      InductionVariableElimination const &state = state_of(header);
+      if (state.isBottom)
+        continue;
+
+      std::vector<Recurrence> recurrences;
+      for (llvm::PHINode &phi : header->phis()) {
+        Recurrence recurrence;
+        if (isRecurrence(phi, *loop, recurrence)) {
+          recurrences.push_back(recurrence);
+        }
+      }
+      if (recurrences.size() < 2)
+        continue;
+
+      // The primary induction variable has the smallest step, so that the
+      // factors of the others are integral
+      Recurrence primary = *std::min_element(
+          recurrences.begin(), recurrences.end(),
+          [](Recurrence const &lhs, Recurrence const &rhs) {
+            return lhs.step.abs().getLimitedValue() <
+                   rhs.step.abs().getLimitedValue();
+          });
+
+      for (Recurrence const &recurrence : recurrences) {
+        if (recurrence.phi == primary.phi)
+          continue;
+        llvm::APInt a, b;
+        if (!state.relation(recurrence, primary, a, b) ||
+            !isInductive(recurrence, primary, *loop, a, b))
+          continue;
+        // The increment of p is computed from the one of q for other users
+        if (!recurrence.increment->hasOneUse() &&
+            !dominators.dominates(primary.increment, recurrence.increment))
+          continue;
+
+        dbgs(3) << "  Replaced induction variable" << *recurrence.phi << " by "
+                << a << " *" << *primary.phi << " + " << b << '\n';
+        eliminate(recurrence, primary, a, b);
+        hasChanged = true;
+      }
+    }
+
+    return hasChanged;
+  }
+
+private:
+  /// A header phi that is incremented by a constant step on every back edge
+  struct Recurrence {
+    llvm::PHINode *phi;
+    llvm::BinaryOperator *increment;
+    llvm::APInt step;
+  };
+
+  static bool isRecurrence(llvm::PHINode &phi, llvm::Loop const &loop,
+                           Recurrence &result) {
+    if (!phi.getType()->isIntegerTy())
+      return false;
+
+    llvm::BinaryOperator *increment = nullptr;
+    for (unsigned i = 0; i < phi.getNumIncomingValues(); ++i) {
+      if (!loop.contains(phi.getIncomingBlock(i)))
+        continue;
+      auto op = dyn_cast<llvm::BinaryOperator>(phi.getIncomingValue(i));
+      if (!op || (increment && op != increment))
+        return false;
+      increment = op;
+    }
+    if (!increment || !loop.contains(increment))
+      return false;
+
+    auto step = dyn_cast<llvm::ConstantInt>(increment->getOperand(1));
+    bool is_add = increment->getOpcode() == llvm::Instruction::Add;
+    if (is_add && !step && increment->getOperand(1) == &phi) {
+      step = dyn_cast<llvm::ConstantInt>(increment->getOperand(0));
+    } else if (increment->getOperand(0) != &phi) {
+      return false;
+    }
+    if (!step ||
+        (!is_add && increment->getOpcode() != llvm::Instruction::Sub))
+      return false;
+
+    result = {&phi, increment, is_add ? step->getValue() : -step->getValue()};
+    return !result.step.isNullValue();
+  }
+
+  /// Finds p = a * q + b in this state, with integral a and b
+  bool relation(Recurrence const &p, Recurrence const &q, llvm::APInt &a,
+                llvm::APInt &b) const {
+    if (!env->contains(p.phi) || !env->contains(q.phi))
+      return false;
+    int dim_p = env->dimension(p.phi);
+    int dim_q = env->dimension(q.phi);
+
+    // Every transformation in the basis maps the relation to zero, i.e.
+    // column p = a * column q + b * column 0. Solve for a and b in the least
+    // squares sense and check the residuals.
+    struct Row {
+      T u, v, w;
+    };
+    std::vector<Row> rows;
+    for (MatrixType const &matrix : basis) {
+      for (int row = 0; row < matrix.getHeight(); ++row) {
+        rows.push_back({matrix.value(row, dim_p), matrix.value(row, dim_q),
+                        matrix.value(row, 0)});
+      }
+    }
+    T vv = 0, vw = 0, ww = 0, uv = 0, uw = 0;
+    for (Row const &r : rows) {
+      vv += r.v * r.v;
+      vw += r.v * r.w;
+      ww += r.w * r.w;
+      uv += r.u * r.v;
+      uw += r.u * r.w;
+    }
+    T determinant = vv * ww - vw * vw;
+    if (std::abs(determinant) < epsilon)
+      return false;
+    T factor = (uv * ww - uw * vw) / determinant;
+    T offset = (vv * uw - vw * uv) / determinant;
+    for (Row const &r : rows) {
+      if (std::abs(r.u - factor * r.v - offset * r.w) > epsilon)
+        return false;
+    }
+
+    T rounded_factor = std::round(factor);
+    T rounded_offset = std::round(offset);
+    if (std::abs(factor - rounded_factor) > epsilon ||
+        std::abs(offset - rounded_offset) > epsilon || rounded_factor == 0)
+      return false;
+    unsigned width = p.phi->getType()->getIntegerBitWidth();
+    a = llvm::APInt(width, static_cast<int64_t>(rounded_factor), true);
+    b = llvm::APInt(width, static_cast<int64_t>(rounded_offset), true);
+    return true;
+  }
+
+  /// Whether p = a * q + b holds on entry to the loop and is kept by the
+  /// increments
+  static bool isInductive(Recurrence const &p, Recurrence const &q,
+                          llvm::Loop const &loop, llvm::APInt const &a,
+                          llvm::APInt const &b) {
+    if (p.phi->getType() != q.phi->getType() || p.step != a * q.step)
+      return false;
+
+    for (unsigned i = 0; i < p.phi->getNumIncomingValues(); ++i) {
+      llvm::BasicBlock *block = p.phi->getIncomingBlock(i);
+      if (loop.contains(block))
+        continue;
+      llvm::Value *start_p = p.phi->getIncomingValue(i);
+      llvm::Value *start_q = q.phi->getIncomingValueForBlock(block);
+      if (start_p == start_q && a.isOneValue() && b.isNullValue())
+        continue;
+      auto constant_p = dyn_cast<llvm::ConstantInt>(start_p);
+      auto constant_q = dyn_cast<llvm::ConstantInt>(start_q);
+      if (!constant_p || !constant_q ||
+          constant_p->getValue() != a * constant_q->getValue() + b)
+        return false;
+    }
+    return true;
+  }
+
+  /// a * value + b, inserted by builder
+  static llvm::Value *affine(llvm::IRBuilder<> &builder, llvm::Value *value,
+                             llvm::APInt const &a, llvm::APInt const &b) {
+    if (!a.isOneValue()) {
+      value = builder.CreateMul(value, builder.getInt(a));
+    }
+    if (!b.isNullValue()) {
+      value = builder.CreateAdd(value, builder.getInt(b));
+    }
+    return value;
+  }
+
+  /// Computes p and its increment from q, and deletes the recurrence of p
+  static void eliminate(Recurrence const &p, Recurrence const &q,
+                        llvm::APInt const &a, llvm::APInt const &b) {
+    llvm::IRBuilder<> builder{&*p.phi->getParent()->getFirstInsertionPt()};
+    llvm::Value *value = affine(builder, q.phi, a, b);
+    if (value != q.phi) {
+      value->takeName(p.phi);
+    }
+    p.phi->replaceUsesWithIf(value, [&p](llvm::Use &use) {
+      return use.getUser() != p.increment;
+    });
+
+    if (!p.increment->hasOneUse()) {
+      builder.SetInsertPoint(p.increment->getNextNode());
+      llvm::Value *next = affine(builder, q.increment, a, b);
+      if (next != q.increment) {
+        next->takeName(p.increment);
+      }
+      p.increment->replaceUsesWithIf(next, [&p](llvm::Use &use) {
+        return use.getUser() != p.phi;
+      });
+    }
+
+    p.phi->dropAllReferences();
+    p.increment->eraseFromParent();
+    p.phi->eraseFromParent();
+  }
+
+  static constexpr T epsilon = 1e-9;
+};
+
+} // namespace pcpo
@@ -65,8 +65,8 @@ IntegerDomain::interpret(llvm::Instruction const &inst,
 }
 
 bool IntegerDomain::operator==(IntegerDomain o) const {
-  if (isBottom() && o.isBottom())
-    return true;
+  if (isBottom() || o.isBottom())
+    return isBottom() == o.isBottom();
 
   auto a = toInt();
   auto b = o.toInt();
@@ -75,14 +75,34 @@ bool IntegerDomain::operator==(IntegerDomain o) const {
     return a.value() == b.value();
   }
 
-  return false;
+  // Top is equal to top, otherwise merging it would never be stable
+  return a.has_value() == b.has_value();
 }
 
 IntegerDomain IntegerDomain::refineBranch(llvm::CmpInst::Predicate pred,
                                           llvm::Value const &a_value,
                                           llvm::Value const &b_value,
                                           IntegerDomain a, IntegerDomain b) {
-  return a;
+  if (a.isBottom() || b.isBottom())
+    return a;
+
+  // Only (in)equality with a constant tells something about a constant
+  auto x = a.toInt();
+  auto y = b.toInt();
+  switch (pred) {
+  case llvm::CmpInst::ICMP_EQ:
+    if (!y.has_value())
+      return a;
+    if (x.has_value() && x.value() != y.value())
+      return IntegerDomain();
+    return b;
+  case llvm::CmpInst::ICMP_NE:
+    if (x.has_value() && y.has_value() && x.value() == y.value())
+      return IntegerDomain();
+    return a;
+  default:
+    return a;
+  }
 }
 
 IntegerDomain IntegerDomain::merge(Merge_op::Type op, IntegerDomain a,
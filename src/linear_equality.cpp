@@ -12,7 +12,7 @@ LinearEquality::LinearEquality(Value const* y) {
     this->b = 0;
 }
     
-LinearEquality::LinearEquality(Value const* y, int64_t a, Value const* x, int64_t b) {
+LinearEquality::LinearEquality(Value const* y, Number a, Value const* x, Number b) {
     this->y = y;
     this->a = a;
     this->x = x;
@@ -23,7 +23,7 @@ LinearEquality::LinearEquality(ConstantInt const* y) {
     this->y = y;
     this->a = 1;
     this->x = nullptr;
-    this->b = y->getSExtValue();
+    this->b = Number {y->getValue()};
 }
     
 raw_ostream& operator<<(raw_ostream& os, LinearEquality a) {
@@ -4,6 +4,7 @@
 #include <llvm/IR/Instructions.h>
 
 #include "global.h"
+#include "number.h"
 
 namespace pcpo {
 
@@ -13,14 +14,14 @@ public:
     LinearEquality() = default;
     LinearEquality(LinearEquality const&) = default;
     LinearEquality(llvm::Value const* y);
-    LinearEquality(llvm::Value const* y, int64_t a, llvm::Value const* x, int64_t b);
+    LinearEquality(llvm::Value const* y, Number a, llvm::Value const* x, Number b);
     LinearEquality(llvm::ConstantInt const* y);
     // y = a * x + b
     llvm::Value const* y;
-    // APInt would be nicer, but our anlysis doesnt care about bit width
-    int64_t a;
+    // Our analysis doesnt care about bit width, but the coefficients must not silently overflow
+    Number a;
     llvm::Value const* x;
-    int64_t b;
+    Number b;
     
     inline bool operator<(LinearEquality const& rhs) const {
         if (y == rhs.y) {
@@ -3,27 +3,25 @@
 
 #include "llvm/IR/CFG.h"
 
-#include <set>
-
 using namespace llvm;
 using std::vector;
 using std::unordered_map;
-using std::set;
 
 namespace pcpo {
 
 // MARK: - Initializers
 
 LinearSubspace::LinearSubspace(Function const& func) {
-    index = createVariableIndexMap(func);
+    env = environmentFor(func);
     basis = {MatrixType(getNumberOfVariables() + 1)};
     isBottom = true;
 }
 
 LinearSubspace::LinearSubspace(Function const* callee_func, LinearSubspace const& state, CallInst const* call) {
     assert(callee_func->arg_size() == call->getNumArgOperands());
-    index = state.index;
+    env = state.env;
     basis = state.basis;
+    changeEnvironment(DimensionEnvironment::join(env, environmentFor(*callee_func)));
 
     for (Argument const& arg: callee_func->args()) {
         Value* value = call->getArgOperand(arg.getArgNo());
@@ -41,34 +39,76 @@ LinearSubspace::LinearSubspace(Function const* callee_func, LinearSubspace const
 // MARK: - AbstractState Interface
 
 void LinearSubspace::applyPHINode(BasicBlock const& bb, vector<LinearSubspace> const& pred_values, Instruction const& phi) {
-    PHINode const* phiNode = dyn_cast<PHINode>(&phi);
+    // The phis of a block are assigned simultaneously, in the state of each predecessor, so that the
+    // relations between them survive the join, e.g. between the induction variables of a loop. All
+    // of them are handled together with the first one.
+    if (&phi != &bb.front()) return;
+
+    LinearSubspace result = *this;
+    result.isBottom = true;
     int i = 0;
 
     for (BasicBlock const* pred_bb: llvm::predecessors(&bb)) {
-        auto& incoming_value = *phiNode->getIncomingValueForBlock(pred_bb);
-        auto& incoming_state = pred_values[i];
-        // Predecessor states should have been merged before. This is just bookkeeping.
-        if (llvm::ConstantInt const* c = llvm::dyn_cast<llvm::ConstantInt>(&incoming_value)) {
-            LinearSubspace acc = *this;
-            acc.affineAssignment(&phi, 1, nullptr, c->getSExtValue());
-            merge(Merge_op::UPPER_BOUND, acc);
-        } else {
-            LinearSubspace acc = *this;
-            for (auto m: incoming_state.basis) {
-                acc.affineAssignment(&phi, 1, &incoming_value, 0);
+        LinearSubspace acc = pred_values[i++];
+        if (acc.isBottom) continue;
+
+        MatrixType Wr = MatrixType(acc.getNumberOfVariables() + 1);
+        for (PHINode const& phiNode: bb.phis()) {
+            if (!acc.env->contains(&phiNode)) continue;
+            auto& incoming_value = *phiNode.getIncomingValueForBlock(pred_bb);
+            int dimension = acc.env->dimension(&phiNode);
+            // Incoming values that are not tracked leave the phi untouched, like any
+            // non-deterministic assignment
+            if (llvm::ConstantInt const* c = llvm::dyn_cast<llvm::ConstantInt>(&incoming_value)) {
+                Wr.setValue(dimension, dimension, 0);
+                Wr.setValue(0, dimension, c->getSExtValue());
+            } else if (acc.env->contains(&incoming_value)) {
+                Wr.setValue(dimension, dimension, 0);
+                Wr.setValue(acc.env->dimension(&incoming_value), dimension, 1);
             }
-            merge(Merge_op::UPPER_BOUND, acc);
         }
-        i++;
+        for (MatrixType& matrix: acc.basis) {
+            matrix *= Wr;
+        }
+        result.merge(Merge_op::UPPER_BOUND, acc);
+    }
+    *this = result;
+}
+
+/// Whether `value` is an argument or instruction of `function`
+static bool isLocalTo(Value const* value, Function const& function) {
+    if (Argument const* arg = dyn_cast_or_null<Argument>(value)) {
+        return arg->getParent() == &function;
+    }
+    if (Instruction const* inst = dyn_cast_or_null<Instruction>(value)) {
+        return inst->getFunction() == &function;
     }
+    return false;
 }
 
 void LinearSubspace::applyCallInst(Instruction const& inst, BasicBlock const* end_block, LinearSubspace const& callee_state) {
     if (callee_state.isBottom) {
         isBottom = true;
-    } else {
-        basis = callee_state.basis;
+        return;
+    }
+
+    // The state of the callee continues the one of the caller, so it is taken over as a whole
+    Function const& caller = *inst.getFunction();
+    Function const& callee = *end_block->getParent();
+    env = callee_state.env;
+    basis = callee_state.basis;
+
+    ReturnInst const* ret_inst = dyn_cast<ReturnInst>(end_block->getTerminator());
+    if (ret_inst && inst.getType()->isIntegerTy() && env->contains(ret_inst) && env->contains(&inst)) {
+        affineAssignment(&inst, 1, ret_inst, 0);
     }
+
+    // Apart from the result, the caller has no use for the variables of the callee. Unless it calls
+    // itself, where they are the variables of the caller as well.
+    if (&callee != &caller) {
+        projectOut([&callee](Value const* value) { return isLocalTo(value, callee); });
+    }
+    changeEnvironment(DimensionEnvironment::join(env, environmentFor(caller)));
 }
 
 void LinearSubspace::applyReturnInst(Instruction const& inst) {
@@ -116,23 +156,45 @@ void LinearSubspace::applyDefault(Instruction const& inst) {
 }
 
 bool LinearSubspace::merge(Merge_op::Type op, LinearSubspace const& other) {
-    index.insert(other.index.begin(), other.index.end());
-
     if (isBottom && other.isBottom) {
+        env = other.env;
         basis = other.basis;
         return false;
     } else if (isBottom && !other.isBottom) {
+        env = other.env;
         basis = other.basis;
         isBottom = false;
         return true;
     } else if (!isBottom && other.isBottom) {
         return false;
-    } else if (!isBottom && !other.isBottom) {
-        switch (op) {
-            case Merge_op::UPPER_BOUND: return leastUpperBound(other);
-            default: abort();
+    }
+
+    // Both states have to be over the same dimensions, which is just a pointer compare in the usual
+    // case of states of the same function.
+    if (env != other.env) {
+        DimensionEnvironment::Ptr joined = DimensionEnvironment::join(env, other.env);
+        changeEnvironment(joined);
+        if (other.env != joined) {
+            LinearSubspace embedded = other;
+            embedded.changeEnvironment(joined);
+            return merge(op, embedded);
         }
     }
+
+    switch (op) {
+        // Subspaces form a lattice of finite height, every strict increase raises the dimension of
+        // the span. So the join is a widening as well.
+        case Merge_op::UPPER_BOUND:
+        case Merge_op::WIDEN:
+            // Stabilization test, at the end of an iteration the stored state is usually reproduced
+            if (basis == other.basis) return false;
+            return leastUpperBound(other);
+        // As widening does not lose precision, narrowing cannot improve the result. Keeping the
+        // state fulfills intersect(state, other) <= narrow(state, other) <= state.
+        case Merge_op::NARROW:
+            return false;
+    }
+    abort();
 }
 
 // MARK: - Lattice Operations
@@ -162,16 +224,98 @@ bool LinearSubspace::leastUpperBound(LinearSubspace const& rhs) {
     return before != basis;
 }
 
+void LinearSubspace::projectOut(std::function<bool(Value const*)> const& remove) {
+    vector<bool> removed = {false};
+    bool any = false;
+    for (Value const* variable: env->getVariables()) {
+        removed.push_back(remove(variable));
+        any |= removed.back();
+    }
+    if (!any) return;
+
+    // Row d holds the contribution of the value of x_d on entry, so x_d can only be removed if no
+    // remaining variable depends on it. Keeping a variable may keep others in turn.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int d = 1; d <= env->size(); d++) {
+            if (!removed[d]) continue;
+            for (MatrixType const& matrix: basis) {
+                for (int column = 0; column <= env->size() && removed[d]; column++) {
+                    if (!removed[column] && matrix.value(d, column) != 0) {
+                        removed[d] = false;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    DimensionEnvironment::Ptr newEnv = DimensionEnvironment::project(env, [&](Value const* variable) {
+        return !removed[env->dimension(variable)];
+    });
+    if (newEnv->size() == env->size()) return;
+
+    vector<int> kept = {0};
+    for (int d = 1; d <= env->size(); d++) {
+        if (!removed[d]) kept.push_back(d);
+    }
+    vector<vector<T>> vectors;
+    for (MatrixType const& matrix: basis) {
+        MatrixType projected = MatrixType(int(kept.size()));
+        for (int row = 0; row < int(kept.size()); row++) {
+            for (int column = 0; column < int(kept.size()); column++) {
+                projected.setValue(row, column, matrix.value(kept[row], kept[column]));
+            }
+        }
+        vectors.push_back(projected.toVector());
+    }
+
+    env = newEnv;
+    if (vectors.empty()) return;
+    // Dropping rows and columns may make the basis linearly dependent
+    MatrixType result = MatrixType::span(MatrixType(vectors), true);
+    basis = result.reshapeColumns(getHeight(), getWidth());
+}
+
+void LinearSubspace::changeEnvironment(DimensionEnvironment::Ptr const& newEnv) {
+    if (env == newEnv) return;
+    assert(newEnv->includes(*env));
+
+    if (*env == *newEnv) {
+        env = newEnv;
+        return;
+    }
+
+    // position of every old dimension in the new environment, the constant stays at 0
+    vector<int> position = {0};
+    for (Value const* variable: env->getVariables()) {
+        position.push_back(newEnv->dimension(variable));
+    }
+
+    int dimensions = newEnv->size() + 1;
+    for (MatrixType& matrix: basis) {
+        MatrixType embedded = MatrixType(dimensions);
+        for (int row = 0; row < int(position.size()); row++) {
+            for (int column = 0; column < int(position.size()); column++) {
+                embedded.setValue(position[row], position[column], matrix.value(row, column));
+            }
+        }
+        matrix = embedded;
+    }
+    env = newEnv;
+}
+
 // MARK: - Assignments
 
 // xi = a1x1 + ... + anxn + a0
 void LinearSubspace::affineAssignment(Value const* xi, unordered_map<Value const*,T> relations, T constant) {
     MatrixType Wr = MatrixType(getNumberOfVariables() + 1);
-    Wr.setValue(index.at(xi),index.at(xi), 0);
-    Wr.setValue(0,index.at(xi), constant);
+    Wr.setValue(env->dimension(xi),env->dimension(xi), 0);
+    Wr.setValue(0,env->dimension(xi), constant);
 
     for (auto [variable, factor]: relations) {
-        Wr.setValue(index.at(variable),index.at(xi), factor);
+        Wr.setValue(env->dimension(variable),env->dimension(xi), factor);
     }
 
     // FIXME: this seems quite inefficient
@@ -201,16 +345,16 @@ void LinearSubspace::affineAssignment(Value const* xi, T a, Value const* xj, T b
 // xi = ?
 void LinearSubspace::nonDeterminsticAssignment(Value const* xi) {
     return;
-    if (index.count(xi) == 0) return;
+    if (!env->contains(xi)) return;
 
     MatrixType T0 = MatrixType(getNumberOfVariables() + 1);
     MatrixType T1 = MatrixType(getNumberOfVariables() + 1);
 
-    T0.setValue(index.at(xi),index.at(xi), 0);
-    T0.setValue(0,index.at(xi), 0);
+    T0.setValue(env->dimension(xi),env->dimension(xi), 0);
+    T0.setValue(0,env->dimension(xi), 0);
 
-    T1.setValue(index.at(xi),index.at(xi), 0);
-    T1.setValue(0,index.at(xi), 1);
+    T1.setValue(env->dimension(xi),env->dimension(xi), 0);
+    T1.setValue(0,env->dimension(xi), 1);
 
     vector<vector<T>> assignment_vectors;
     assignment_vectors.push_back(T0.toVector());
@@ -302,52 +446,59 @@ void LinearSubspace::Mul(Instruction const& inst) {
 
 // MARK: - Helpers
 
-unordered_map<Value const*, int> createVariableIndexMap_impl(Function const& func, int& count, set<Function const*>& visited_funcs) {
-    unordered_map<Value const*, int> map;
-    visited_funcs.insert(&func);
+/// The arguments and instructions of `func` that are tracked. The variables of a callee are only
+/// added to a state while the callee is analyzed, see the call constructor and `applyCallInst`.
+void collectVariables(Function const& func, vector<Value const*>& variables) {
+    for (Argument const& arg: func.args()) {
+        if (isa<IntegerType>(arg.getType())) {
+            variables.push_back(&arg);
+        }
+    }
     for (BasicBlock const& basic_block: func) {
         for (Instruction const& inst: basic_block) {
             if (isa<IntegerType>(inst.getType()) || isa<ReturnInst>(&inst)) {
-                count++;
-                map[&inst] = count;
+                variables.push_back(&inst);
             }
-            if (CallInst const* call = dyn_cast<CallInst>(&inst)) {
-                Function const* callee_func = call->getCalledFunction();
-                if (callee_func->empty()) {
-                    continue;
-                }
-                if (visited_funcs.count(callee_func) == 0) {
-                    for (Argument const& arg: callee_func->args()) {
-                        if (isa<IntegerType>(arg.getType())) {
-                            count++;
-                            map[&arg] = count;
-                        }
-                    }
-                    unordered_map<Value const*, int> callee_map = createVariableIndexMap_impl(*callee_func, count, visited_funcs);
-                    map.merge(callee_map);
-                }
-            } 
         }
     }
-    return map;
 }
 
-unordered_map<Value const*, int> LinearSubspace::createVariableIndexMap(Function const& func) {
-    int count = 0;
-    set<Function const*> visited_funcs = {};
-    return createVariableIndexMap_impl(func, count, visited_funcs);
+namespace {
+
+/// Cache of the run the current thread analyzes for, if any
+thread_local LinearSubspace::Cache* current_cache = nullptr;
+
 }
 
-// MARK: - debug output
+LinearSubspace::Cache::Scope::Scope(Cache& cache): previous {current_cache} {
+    current_cache = &cache;
+}
+
+LinearSubspace::Cache::Scope::~Scope() {
+    current_cache = previous;
+}
 
-unordered_map<int,Value const*> reverseMap(unordered_map<Value const*, int> const& map) {
-    unordered_map<int,Value const*> reversed;
-    for (auto [key, value]: map) {
-        reversed[value] = key;
+DimensionEnvironment::Ptr LinearSubspace::environmentFor(Function const& func) {
+    auto make = [&func]() {
+        vector<Value const*> variables;
+        collectVariables(func, variables);
+        return DimensionEnvironment::make(variables);
+    };
+    Cache* cache = current_cache;
+    if (!cache) {
+        return make();
     }
-    return reversed;
+
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    DimensionEnvironment::Ptr& env = cache->environments[&func];
+    if (!env) {
+        env = make();
+    }
+    return env;
 }
 
+// MARK: - debug output
+
 void LinearSubspace::print() const {
     dbgs(3) << *this;
 }
@@ -359,9 +510,8 @@ void LinearSubspace::printIncoming(BasicBlock const& bb, raw_ostream& out, int i
 void LinearSubspace::printOutgoing(BasicBlock const& bb, raw_ostream& out, int indentation) const {
     MatrixType nullspace = MatrixType::null(MatrixType(this->basis));
 
-    auto reversed = reverseMap(index);
-    for (int i = 1; i <= int(index.size()); i++) {
-        auto val = reversed.at(i);
+    for (int i = 1; i <= env->size(); i++) {
+        auto val = env->variable(i);
         if (val->hasName()) {
             out << left_justify(val->getName(), 6);
         } else {
@@ -378,14 +528,13 @@ void LinearSubspace::debug_output(Instruction const& inst, MatrixType operands)
 
 
 raw_ostream& operator<<(raw_ostream& os, LinearSubspace const& relation) {
-    auto reversed = reverseMap(relation.index);
     if (relation.basis.empty()) {
         return os << "[]\n";
     }
     for (auto m: relation.basis) {
         os << left_justify("", 8);
-        for (int i = 1; i <= int(relation.index.size()); i++) {
-            auto val = reversed.at(i);
+        for (int i = 1; i <= relation.env->size(); i++) {
+            auto val = relation.env->variable(i);
             if (val->hasName()) {
                 os << left_justify(val->getName(), 6);
             } else {
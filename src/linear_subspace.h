@@ -1,30 +1,54 @@
 #pragma once
 
 #include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
 
 #include "global.h"
+#include "dimension_environment.h"
 #include "simple_matrix.h"
 #include "sparse_matrix.h"
 
+#include <functional>
+#include <mutex>
 #include <unordered_map>
 
 namespace pcpo {
 
 class LinearSubspace {
 private:
-    /// Only valid when `createVariableIndexMap` has been generated.
-    int getNumberOfVariables() const { return index.size(); };
-    std::unordered_map<llvm::Value const*, int> createVariableIndexMap(llvm::Function const& func);
+    int getNumberOfVariables() const { return env->size(); };
+    /// Environment of the arguments and variables of `func`, shared with the other states of the
+    /// run if there is a `Cache::Scope` on this thread.
+    static DimensionEnvironment::Ptr environmentFor(llvm::Function const& func);
 public:
+    /// The environments of the functions, computed once per run of the fixpoint engine. The
+    /// states of a run share them, while a `Scope` of the cache exists on their thread.
+    class Cache {
+    public:
+        class Scope {
+        public:
+            explicit Scope(Cache& cache);
+            ~Scope();
+            Scope(Scope const&) = delete;
+            Scope& operator=(Scope const&) = delete;
+        private:
+            Cache* previous;
+        };
+    private:
+        friend class LinearSubspace;
+        std::mutex mutex;
+        std::unordered_map<llvm::Function const*, DimensionEnvironment::Ptr> environments;
+    };
+
     /// Type used for Matrix values.
     using T = double;
     using MatrixType = SparseMatrix<T>;
 
-    std::unordered_map<llvm::Value const*, int> index;
+    DimensionEnvironment::Ptr env = DimensionEnvironment::empty();
     std::vector<MatrixType> basis;
     bool isBottom = true;
-    int getWidth() { return index.size() + 1; };
-    int getHeight() { return index.size() + 1; };
+    int getWidth() { return env->size() + 1; };
+    int getHeight() { return env->size() + 1; };
 
     LinearSubspace() = default;
     LinearSubspace(LinearSubspace const& state) = default;
@@ -47,6 +71,16 @@ public:
     bool merge(Merge_op::Type op, LinearSubspace const& other);
     void branch(llvm::BasicBlock const& from, llvm::BasicBlock const& towards) { return; };
     bool leastUpperBound(LinearSubspace const& rhs);
+    /// Keeps every variable. The states of a callee carry the relations of its caller, which
+    /// `applyCallInst` takes over on return, so the variables of other functions must stay. The
+    /// callee's own ones are projected out there instead.
+    void project(std::function<bool(llvm::Value const*)> const& keep) {};
+    /// Removes the variables for which `remove` returns true, unless a remaining variable depends
+    /// on their value on entry.
+    void projectOut(std::function<bool(llvm::Value const*)> const& remove);
+    /// Embeds the basis into `newEnv`, which has to include the current environment. Variables
+    /// that are new are left untouched by every transformation.
+    void changeEnvironment(DimensionEnvironment::Ptr const& newEnv);
 
     bool checkOperandsForBottom(llvm::Instruction const& inst) { return false; }
 
@@ -0,0 +1,110 @@
+#include "liveness.h"
+
+#include <vector>
+
+#include <llvm/ADT/PostOrderIterator.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Instructions.h>
+
+namespace pcpo {
+
+using namespace llvm;
+
+Liveness::Liveness(Function const &function) : function{&function} {
+  if (function.empty()) {
+    return;
+  }
+
+  // Blocks that are not reachable from the entry are never analyzed
+  std::vector<BasicBlock const *> order;
+  for (BasicBlock const *basic_block : post_order(&function.getEntryBlock())) {
+    order.push_back(basic_block);
+  }
+
+  // Backwards dataflow in post order, so that most successors are done before
+  // their predecessors. The incoming values of a phi are live at the end of
+  // the corresponding predecessor, not at the start of the phi's block.
+  std::unordered_map<BasicBlock const *, std::unordered_set<Value const *>>
+      live_in;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (BasicBlock const *basic_block : order) {
+      std::unordered_set<Value const *> live;
+      for (BasicBlock const *succ : successors(basic_block)) {
+        auto it = live_in.find(succ);
+        if (it != live_in.end()) {
+          live.insert(it->second.begin(), it->second.end());
+        }
+        for (PHINode const &phi : succ->phis()) {
+          Value const *value = phi.getIncomingValueForBlock(basic_block);
+          if (isLocal(value)) {
+            live.insert(value);
+          }
+        }
+      }
+      for (Instruction const &inst : reverse(*basic_block)) {
+        live.erase(&inst);
+        if (isa<PHINode>(inst)) {
+          continue;
+        }
+        for (Value const *operand : inst.operand_values()) {
+          if (isLocal(operand)) {
+            live.insert(operand);
+          }
+        }
+      }
+
+      // The sets only grow, so their sizes tell whether they changed
+      std::unordered_set<Value const *> &before = live_in[basic_block];
+      if (live.size() != before.size()) {
+        before = std::move(live);
+        changed = true;
+      }
+    }
+  }
+
+  for (BasicBlock const *basic_block : order) {
+    std::unordered_set<Value const *> &values = needed[basic_block];
+    values = live_in[basic_block];
+    for (Instruction const &inst : *basic_block) {
+      values.insert(&inst);
+    }
+    auto branch = dyn_cast<BranchInst>(basic_block->getTerminator());
+    auto compare = branch && branch->isConditional()
+                       ? dyn_cast<CmpInst>(branch->getCondition())
+                       : nullptr;
+    if (compare) {
+      for (Value const *operand : compare->operand_values()) {
+        if (isLocal(operand)) {
+          values.insert(operand);
+        }
+      }
+    }
+  }
+}
+
+bool Liveness::isNeeded(BasicBlock const *basic_block,
+                        Value const *value) const {
+  if (!isa_and_nonnull<Argument>(value) &&
+      !isa_and_nonnull<Instruction>(value)) {
+    return true;
+  }
+  if (!isLocal(value)) {
+    return false;
+  }
+  auto it = needed.find(basic_block);
+  return it != needed.end() && it->second.count(value);
+}
+
+bool Liveness::isLocal(Value const *value) const {
+  if (auto arg = dyn_cast_or_null<Argument>(value)) {
+    return arg->getParent() == function;
+  }
+  if (auto inst = dyn_cast_or_null<Instruction>(value)) {
+    return inst->getFunction() == function;
+  }
+  return false;
+}
+
+} // namespace pcpo
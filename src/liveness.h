@@ -0,0 +1,36 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Value.h>
+
+namespace pcpo {
+
+/// The values of a function that the state at the end of a block still needs.
+/// These are the values live into the block and the ones defined in it, as the
+/// transformations read the state of a block for its instructions and their
+/// operands. The operands of the compare of a conditional branch are kept too,
+/// because branch refines them. Values of other functions, e.g. of a callee,
+/// are never needed, all others (globals, constants) always are.
+class Liveness {
+public:
+  explicit Liveness(llvm::Function const &function);
+
+  /// Whether the state at the end of basic_block needs value
+  bool isNeeded(llvm::BasicBlock const *basic_block,
+                llvm::Value const *value) const;
+
+private:
+  /// Whether value is an argument or instruction of the function
+  bool isLocal(llvm::Value const *value) const;
+
+  llvm::Function const *function;
+  std::unordered_map<llvm::BasicBlock const *,
+                     std::unordered_set<llvm::Value const *>>
+      needed;
+};
+
+} // namespace pcpo
@@ -7,6 +7,10 @@
 
 #include "normalized_conjunction.h"
 
+#include <algorithm>
+#include <numeric>
+
+#include "llvm/ADT/Hashing.h"
 #include "llvm/IR/CFG.h"
 
 using namespace llvm;
@@ -17,8 +21,7 @@ namespace pcpo {
 
 NormalizedConjunction::NormalizedConjunction(Function const& f) {
     for (Argument const& arg: f.args()) {
-        get(&arg) = LinearEquality(&arg);
-        validVariables.insert(&arg);
+        ensure(&arg);
     }
     isBottom = f.arg_empty();
 }
@@ -29,25 +32,34 @@ NormalizedConjunction::NormalizedConjunction(Function const* callee_func, Normal
         Value* value = call->getArgOperand(arg.getArgNo());
         if (value->getType()->isIntegerTy()) {
             if (ConstantInt const* c = dyn_cast<ConstantInt>(value)) {
-                get(&arg) = { &arg, 1 , nullptr, c->getSExtValue() };
-            } else if (state.values.count(value) > 0) {
-                LinearEquality value_equality = state.values.at(value);
-                LinearEquality eq = { &arg, value_equality.a , value_equality.x, value_equality.b };
-                get(&arg) = { &arg, value_equality.a , value_equality.x, value_equality.b };
+                linearAssignment(&arg, 1, nullptr, Number {c->getValue()});
+            } else if (state.env->contains(value)) {
+                LinearEquality value_equality = state[value];
+                linearAssignment(&arg, value_equality.a, value_equality.x, value_equality.b);
             } else {
-                get(&arg) = { &arg, 1 , value, 0 };
+                linearAssignment(&arg, 1, value, 0);
             }
-            validVariables.insert(&arg);
         }
     }
     isBottom = false;
 }
 
 NormalizedConjunction::NormalizedConjunction(std::unordered_map<Value const*, LinearEquality> const& equalaties) {
-    this->values = equalaties;
     isBottom = equalaties.empty();
+    std::vector<Value const*> variables;
     for (auto& [key, value]: equalaties) {
-        validVariables.insert(key);
+        variables.push_back(key);
+    }
+    std::sort(variables.begin(), variables.end());
+
+    for (Value const* variable: variables) {
+        ensure(variable);
+    }
+    for (Value const* variable: variables) {
+        LinearEquality const& eq = equalaties.at(variable);
+        if (!eq.isTrivial()) {
+            linearAssignment(variable, eq.a, eq.x, eq.b);
+        }
     }
 }
 
@@ -67,9 +79,9 @@ void NormalizedConjunction::applyPHINode(BasicBlock const& bb, std::vector<Norma
 
         if (ConstantInt const* c = dyn_cast<ConstantInt>(&incoming_value)) {
             NormalizedConjunction acc = *this;
-            acc.linearAssignment(&phi, 1, nullptr, c->getSExtValue());
+            acc.linearAssignment(&phi, 1, nullptr, Number {c->getValue()});
             merge(Merge_op::UPPER_BOUND, acc);
-        } else if (incoming_state.values.count(&incoming_value) != 0) {
+        } else if (incoming_state.env->contains(&incoming_value)) {
             NormalizedConjunction acc = *this;
             LinearEquality pred_value = incoming_state[&incoming_value];
             acc.linearAssignment(&phi, pred_value.a, pred_value.x, pred_value.b);
@@ -83,6 +95,17 @@ void NormalizedConjunction::applyPHINode(BasicBlock const& bb, std::vector<Norma
     }
 }
 
+/// Whether `value` is an argument or instruction of `function`
+static bool isLocalTo(Value const* value, Function const& function) {
+    if (Argument const* arg = dyn_cast_or_null<Argument>(value)) {
+        return arg->getParent() == &function;
+    }
+    if (Instruction const* inst = dyn_cast_or_null<Instruction>(value)) {
+        return inst->getFunction() == &function;
+    }
+    return false;
+}
+
 void NormalizedConjunction::applyCallInst(Instruction const& inst, BasicBlock const* end_block, NormalizedConjunction const& callee_state) {
     std::vector<LinearEquality> operands;
 
@@ -91,11 +114,15 @@ void NormalizedConjunction::applyCallInst(Instruction const& inst, BasicBlock co
         if (ReturnInst const* ret_inst = dyn_cast<ReturnInst>(&iter_inst)) {
             Value const* ret_val = ret_inst->getReturnValue();
             dbgs(4) << "\t\tFound return instruction\n";
-            if (callee_state.values.find(ret_val) != callee_state.values.end()) {
+            if (callee_state.env->contains(ret_val)) {
                 dbgs(4) << "\t\tReturn evaluated, merging parameters\n";
-                LinearEquality retEq = callee_state.values.at(ret_val);
-                get(&inst) = {&inst, retEq.a, retEq.x, retEq.b};
-                validVariables.insert(&inst);
+                LinearEquality retEq = callee_state[ret_val];
+                // Values of the callee belong to this call only, the caller cannot refer to them
+                if (isLocalTo(retEq.x, *end_block->getParent())) {
+                    nonDeterminsticAssignment(&inst);
+                } else {
+                    linearAssignment(&inst, retEq.a, retEq.x, retEq.b);
+                }
             } else {
                 dbgs(4) << "\t\tReturn not evaluated, setting to bottom\n";
             }
@@ -107,13 +134,12 @@ void NormalizedConjunction::applyReturnInst(Instruction const& inst) {
     Value const* ret_val = dyn_cast<ReturnInst>(&inst)->getReturnValue();
     if (ret_val && ret_val->getType()->isIntegerTy()) {
         if (ConstantInt const* c = dyn_cast<ConstantInt>(ret_val)) {
-            get(&inst) = LinearEquality(c);
-        } else if (values.find(ret_val) != values.end()) {
-            LinearEquality eq = values.at(ret_val);
-            get(&inst) = {&inst, eq.a, eq.x, eq.b};
+            linearAssignment(&inst, 1, nullptr, Number {c->getValue()});
+        } else if (env->contains(ret_val)) {
+            linearAssignment(&inst, 1, ret_val, 0);
         }
     }
-    validVariables.insert(&inst);
+    ensure(&inst);
 }
 
 void NormalizedConjunction::applyDefault(Instruction const& inst) {
@@ -159,250 +185,206 @@ bool NormalizedConjunction::merge(Merge_op::Type op, NormalizedConjunction const
     if (other.isBottom) {
         return false;
     } else if (isBottom) {
-        values = other.values;
-        validVariables = other.validVariables;
+        env = other.env;
+        entries = other.entries;
         isBottom = false;
         return true;
     }
 
     switch (op) {
-        case Merge_op::UPPER_BOUND: return leastUpperBound(other);
-        default: abort();
+        // Affine equalities form a lattice of finite height, every strict increase drops at least
+        // one equality. So the join is a widening as well.
+        case Merge_op::UPPER_BOUND:
+        case Merge_op::WIDEN:
+            // Stabilization test, at the end of an iteration the stored state is usually reproduced
+            if (*env == *other.env && *this == other) return false;
+            return leastUpperBound(other);
+        // As widening does not lose precision, narrowing cannot improve the result. Keeping the
+        // state fulfills intersect(state, other) <= narrow(state, other) <= state.
+        case Merge_op::NARROW:
+            return false;
     }
+    abort();
 }
 
 // MARK: - Lattice Operations
 
-bool NormalizedConjunction::leastUpperBound(NormalizedConjunction rhs) {
-    // set of all occuring variables in E1 and E2
-    std::set<Value const*> vars, varsE1, varsE2;
-    std::set<LinearEquality> E1, E2;
+/// Removes the variables that keep rejects, preserving the relations between the remaining ones.
+void NormalizedConjunction::project(std::function<bool(Value const*)> const& keep) {
+    if (isBottom) return;
+    std::vector<Value const*> removed;
+    for (Value const* variable: env->getVariables()) {
+        if (!keep(variable)) removed.push_back(variable);
+    }
+    if (removed.empty()) return;
 
-    auto mapToSeccond = [](std::pair<Value const*, LinearEquality> p){ return p.second; };
-    transform(values, std::inserter(E1, E1.end()), mapToSeccond);
-    transform(rhs.values, std::inserter(E2, E2.end()), mapToSeccond);
-    
-    auto mapToY = [](LinearEquality eq){ return eq.y; };
-    transform(E1, std::inserter(varsE1, varsE1.end()), mapToY);
-    transform(E2, std::inserter(varsE2, varsE2.end()), mapToY);
-    std::set_union(varsE1.begin(), varsE1.end(), varsE2.begin(), varsE2.end(), std::inserter(vars, vars.end()));
-    
-    std::set<Value const*> dX1, dX2;
-    
-    std::set_difference(vars.begin(), vars.end(), varsE1.begin(), varsE1.end(), std::inserter(dX1, dX1.end()));
-    std::set_difference(vars.begin(), vars.end(), varsE2.begin(), varsE2.end(), std::inserter(dX2, dX2.end()));
-            
-    // extend E1 by trivial equalities
-    for (auto d: dX1) {
-        if (validVariables.count(d) > 0) {
-            LinearEquality eq = {d, 1, d, 0};
-            E1.insert(eq);
-        } else {
-            E1.insert(rhs[d]);
-        }
+    // Afterwards, no remaining variable refers to a removed one
+    for (Value const* variable: removed) {
+        nonDeterminsticAssignment(variable);
     }
-    
-    // extend E2 by trivial equalities
-    for (auto d: dX2) {
-        if (rhs.validVariables.count(d) > 0) {
-            LinearEquality eq = {d, 1, d, 0};
-            E2.insert(eq);
-        } else {
-            E2.insert(operator[](d));
+
+    DimensionEnvironment::Ptr newEnv = DimensionEnvironment::project(env, keep);
+    std::vector<int> position(env->size() + 1, 0);
+    for (int d = 1; d <= env->size(); d++) {
+        if (newEnv->contains(env->variable(d))) {
+            position[d] = newEnv->dimension(env->variable(d));
         }
     }
-    
-    std::set<LinearEquality> X0 = computeX0(E1, E2);
-    std::set<LinearEquality> X1 = computeX1(E1, E2);
-    std::set<LinearEquality> X2 = computeX2(E1, E2);
-    std::set<LinearEquality> X3 = computeX2(E2, E1);
-    std::set<LinearEquality> X4 = computeX4(E1, E2);
-    
-    // E1 U E2 = E'0 AND E'1 AND E'2 AND E'3 AND E'4
-    
-    std::set<LinearEquality> leastUpperBound;
-    leastUpperBound.insert(X0.begin(), X0.end());
-    leastUpperBound.insert(X1.begin(), X1.end());
-    leastUpperBound.insert(X2.begin(), X2.end());
-    leastUpperBound.insert(X3.begin(), X3.end());
-    leastUpperBound.insert(X4.begin(), X4.end());
-    
-    std::unordered_map<Value const*, LinearEquality> result;
-    
-    auto addMapping = [](LinearEquality eq){ return std::make_pair(eq.y,eq); };
-    transform(leastUpperBound, std::inserter(result, result.end()), addMapping);
 
-    bool changed = values != result;
-    
-    values = result;
-    validVariables.insert(rhs.validVariables.begin(), rhs.validVariables.end());
+    std::vector<Entry> result(newEnv->size());
+    for (int d = 1; d <= env->size(); d++) {
+        if (position[d] == 0) continue;
+        Entry const& e = entry(d);
+        result[position[d] - 1] = {position[e.parent], e.factor, e.offset, position[e.prev], position[e.next]};
+    }
 
-    return changed;
+    env = newEnv;
+    entries = std::move(result);
 }
 
-// MARK: Helpers
+namespace {
 
-/// XO / E'0: set of variables where the right hand side in E1 and E2 coincide
-std::set<LinearEquality> NormalizedConjunction::computeX0(std::set<LinearEquality> const& E1, std::set<LinearEquality> const& E2) {
-    std::set<LinearEquality> X0;
-    std::set_intersection(E1.begin(), E1.end(), E2.begin(), E2.end(), std::inserter(X0, X0.end()));
-    // Remove trivial equalities
-    std::set<LinearEquality> filteredX0;
-    auto filterTrivialEqualaties = [](LinearEquality eq){ return eq.y != eq.x;};
-    copy_if(X0, std::inserter(filteredX0, filteredX0.end()), filterTrivialEqualaties);
-    
-    return filteredX0;
-}
+/// Two variables end up in the same class of the join, iff they have the same key. For variables
+/// that are constant on a side, the corresponding representative is 0.
+struct JoinKey {
+    int rep1;
+    int rep2;
+    Number values[2];
 
-/// X1 / E'1: set of variables where the right hand side is constant but does not coincide in E1 and E2
-std::set<LinearEquality> NormalizedConjunction::computeX1(std::set<LinearEquality> const& E1, std::set<LinearEquality> const& E2) {
-    std::set<LinearEquality> X1;
-    std::set<std::pair<LinearEquality, LinearEquality>> differentConstants;
-    
-    assert(E1.size() == E2.size() && "E1 and E2 should have the same set of variables in the same order");
-    
-    for (auto itE1 = E1.begin(), itE2 = E2.begin(); itE1 != E1.end() && itE2 != E2.end(); ++itE1, ++itE2) {
-        auto eq1 = *itE1;
-        auto eq2 = *itE2;
-        assert(eq1.y == eq2.y && "left hand side of equations should be the same");
-        if (eq1.isConstant() && eq2.isConstant() && eq1.b != eq2.b) {
-            differentConstants.insert({eq1,eq2});
-        }
+    bool operator==(JoinKey const& o) const {
+        return rep1 == o.rep1 && rep2 == o.rep2 && std::equal(values, values + 2, o.values);
     }
-    
-    if (!differentConstants.empty()) {
-        // pop first element
-        std::pair<LinearEquality, LinearEquality> h = *differentConstants.begin();
-        differentConstants.erase(differentConstants.begin());
-        
-        for (auto i: differentConstants) {
-            // find a linear equation that contains both points P1(c(1)i, c(1)h) and P2(c(2)i, c(2)h)
-            // y = a * x + b
-            auto y = i.first.y;
-            int64_t a = ((i.second.b - i.first.b)) / (h.second.b - h.first.b);
-            auto x = h.first.y;
-            int64_t b = -a * h.first.b + i.first.b;
-            LinearEquality eq = {y, a, x, b};
-            X1.insert(eq);
-        }
+};
+
+struct JoinKeyHash {
+    size_t operator()(JoinKey const& k) const {
+        return hash_combine(k.rep1, k.rep2, hash_combine_range(k.values, k.values + 2));
     }
-    return X1;
+};
+
+/// Equality of a variable on one side of the join, in terms of the representative of that side.
+struct Side {
+    int rep;
+    Number a;
+    Number b;
+
+    bool isConstant() const { return rep == 0; };
+};
+
 }
 
-/// X2 / E'2: set of variables where the right hand side of E1 is constant but the rhs of E2 contains a variable.
-std::set<LinearEquality> NormalizedConjunction::computeX2(std::set<LinearEquality> const& E1, std::set<LinearEquality> const& E2) {
-    std::set<LinearEquality> X2;
-    std::set<std::pair<LinearEquality, LinearEquality>> differentConstants;
-    
-    assert(E1.size() == E2.size() && "E1 and E2 should have the same set of variables in the same order");
-    
-    for (auto itE1 = E1.begin(), itE2 = E2.begin(); itE1 != E1.end() && itE2 != E2.end(); ++itE1, ++itE2) {
-        auto eq1 = *itE1;
-        auto eq2 = *itE2;
-        assert(eq1.y == eq2.y && "left hand side of equations should be the same");
-        if (eq1.isConstant() && !eq2.isConstant()) {
-            differentConstants.insert({eq1,eq2});
-        }
+/// The join of two normalized conjunctions, see "Compiler Design: Analysis and Transformation". The
+/// classes of the result are the non-empty sets of variables that are affinely related to each
+/// other in both states. Instead of computing the sets X0 to X4 of the book separately, every
+/// variable is hashed by a key that identifies its class, which makes the join linear in the number
+/// of variables:
+///   - constant on both sides with the same value: stays constant.
+///   - constant on both sides (c1, c2) otherwise: all of these are related by a line.
+///   - constant c1 on the left, a2 * r2 + b2 on the right: (r2, (c1 - b2) / a2)
+///   - a1 * r1 + b1 on the left, constant c2 on the right: (r1, (c2 - b1) / a1)
+///   - a1 * r1 + b1 on the left, a2 * r2 + b2 on the right: (r1, r2, a1 / a2, (b1 - b2) / a1)
+/// The member with the smallest dimension becomes the representative of a class.
+bool NormalizedConjunction::leastUpperBound(NormalizedConjunction rhs) {
+    // Variables that are only assigned on one side are not constrained on the other one. Usually
+    // both sides have the same environment, so the copy of this state is avoided.
+    NormalizedConjunction extended;
+    bool extend = !env->includes(*rhs.env);
+    if (extend) {
+        extended = *this;
+        extended.adoptUnknownVariables(rhs);
     }
-    
-    std::vector<std::set<std::pair<LinearEquality, LinearEquality>>> Pi2;
-    
-    for (auto jt = differentConstants.begin(); jt != differentConstants.end();) {
-        std::set<std::pair<LinearEquality, LinearEquality>> equivalenceClass;
-        auto j = *jt;
-        equivalenceClass.insert(j);
-        jt = differentConstants.erase(jt);
-        
-        // partition differentConstants
-        for (auto it = jt; it != differentConstants.end(); ) {
-            auto i = *it;
-            bool condition1 = i.second.x == j.second.x;
-            bool condition2 = (i.first.b - i.second.b) / (i.second.a) == (j.first.b - j.second.b) / (j.second.a);
-            if (condition1 && condition2) {
-                equivalenceClass.insert(i);
-                it = differentConstants.erase(it);
-                jt = differentConstants.begin();
-            } else {
-                it++;
-            }
-        }
-                
-        Pi2.push_back(equivalenceClass);
+    NormalizedConjunction const& lhs = extend ? extended : *this;
+    if (!rhs.env->includes(*env)) {
+        rhs.adoptUnknownVariables(*this);
     }
-    
-    // form equaltites for partitions in Pi2
-    for (auto q: Pi2) {
-        auto h = *q.begin();
-        q.erase(q.begin());
-        for (auto i: q) {
-            // xi = ai/ah * xh + ( bi - (ai * bh) / ah)
-            auto y = i.first.y;
-            auto a = i.second.a / h.second.a;
-            auto x = h.first.y;
-            auto b = i.second.b - (i.second.a * h.second.b) / h.second.a;
-            LinearEquality eq = {y, a, x, b};
-            X2.insert(eq);
+    rhs.changeEnvironment(lhs.env);
+
+    auto side = [](NormalizedConjunction const& state, int dim) {
+        Entry const& e = state.entry(dim);
+        return Side {e.parent, e.parent == 0 ? 0 : e.factor, e.offset};
+    };
+
+    int size = lhs.env->size();
+    std::vector<Entry> result;
+    result.reserve(size);
+    // Key of a class -> its representative
+    std::unordered_map<JoinKey, int, JoinKeyHash> classes;
+    classes.reserve(size);
+
+    for (int d = 1; d <= size; d++) {
+        Side s1 = side(lhs, d);
+        Side s2 = side(rhs, d);
+        result.push_back({d, 1, 0, d, d});
+
+        JoinKey key;
+        if (s1.isConstant() && s2.isConstant()) {
+            if (s1.b == s2.b) {
+                result.back() = {0, 1, s1.b, d, d};
+                continue;
+            }
+            key = {0, 0, {0, 0}};
+        } else if (s1.isConstant()) {
+            key = {0, s2.rep, {(s1.b - s2.b) / s2.a, 0}};
+        } else if (s2.isConstant()) {
+            key = {s1.rep, 0, {(s2.b - s1.b) / s1.a, 0}};
+        } else {
+            key = {s1.rep, s2.rep, {s1.a / s2.a, (s1.b - s2.b) / s1.a}};
         }
-    }
-    return X2;
-}
 
-std::set<LinearEquality> NormalizedConjunction::computeX4(std::set<LinearEquality> const& E1, std::set<LinearEquality> const& E2) {
-    std::set<LinearEquality> X4;
-    std::set<std::pair<LinearEquality, LinearEquality>> differentConstants;
-    
-    assert(E1.size() == E2.size() && "E1 and E2 should have the same set of variables in the same order");
-    
-    for (auto itE1 = E1.begin(), itE2 = E2.begin(); itE1 != E1.end() && itE2 != E2.end(); ++itE1, ++itE2) {
-        auto eq1 = *itE1;
-        auto eq2 = *itE2;
-        assert(eq1.y == eq2.y && "left hand side of equations should be the same");
-        if (!eq1.isConstant() && !eq2.isConstant() && eq1 != eq2) {
-            differentConstants.insert({eq1,eq2});
+        auto [it, inserted] = classes.insert({key, d});
+        if (inserted) continue;
+
+        // x_d = alpha * x_h + beta has to hold on both sides
+        int h = it->second;
+        Side h1 = side(lhs, h);
+        Side h2 = side(rhs, h);
+        Number numerator, denominator, base_d, base_h;
+        if (s1.isConstant() && s2.isConstant()) {
+            numerator = s2.b - s1.b; denominator = h2.b - h1.b;
+        } else if (s1.isConstant()) {
+            numerator = s2.a; denominator = h2.a;
+        } else {
+            numerator = s1.a; denominator = h1.a;
         }
-    }
-    
-    std::vector<std::set<std::pair<LinearEquality, LinearEquality>>> Pi4;
-    
-    // partition differentConstants
-    for (auto it = differentConstants.begin(); it != differentConstants.end();) {
-        std::set<std::pair<LinearEquality, LinearEquality>> equivalenceClass;
-        std::pair<LinearEquality, LinearEquality> i = *it;
-        equivalenceClass.insert(i);
-        it = differentConstants.erase(it);
-        
-        for (auto jt = it; jt != differentConstants.end(); ) {
-            std::pair<LinearEquality, LinearEquality> j = *jt;
-            bool condition1 = i.first.x == j.first.x && i.second.x == j.second.x;
-            bool condition2 = i.second.a / (i.first.a) == j.second.a / (j.first.a);
-            bool condition3 = (i.first.b - i.second.b) / (i.first.a) == (j.first.b - j.second.b) / (j.first.a);
-            if (condition1 && condition2 && condition3) {
-                equivalenceClass.insert(j);
-                jt = differentConstants.erase(jt);
-                it = differentConstants.begin();
-            } else {
-                jt++;
-            }
+        // For the rhs-only relation, the offset is computed on the right side
+        if (s1.isConstant() && !s2.isConstant()) {
+            base_d = s2.b; base_h = h2.b;
+        } else {
+            base_d = s1.b; base_h = h1.b;
         }
 
-        Pi4.push_back(equivalenceClass);
+        Number alpha = numerator / denominator;
+        if (!alpha.isInteger()) {
+            // Precision loss due to int division, x_d stays in a class of its own
+            continue;
+        }
+        Number beta = base_d - alpha * base_h;
+        result.back() = {h, alpha, beta, d, d};
+
+        // link into the class of h
+        Entry& rep = result[h - 1];
+        result.back().prev = rep.prev;
+        result.back().next = h;
+        result[rep.prev - 1].next = d;
+        rep.prev = d;
     }
-    
-    // form equaltites for partitions in Pi4
-    for (auto q: Pi4) {
-        auto h = *q.begin();
-        q.erase(q.begin());
-        for (auto i: q) {
-            // xi = ai/ah * xh + ( bi - (ai * bh) / ah)
-            auto y = i.first.y;
-            auto a = i.second.a / h.second.a;
-            auto x = h.first.y;
-            auto b = i.second.b - (i.second.a * h.second.b) / (h.second.a);
-            LinearEquality eq = {y, a, x, b};
-            X4.insert(eq);
+
+    // The join only grows, so it changed the state iff an equality was dropped. Comparing the
+    // entries instead would also report a change if only the representatives were renamed.
+    if (!extend) {
+        int equalities_before = 0;
+        int equalities_after = 0;
+        for (int d = 1; d <= size; d++) {
+            equalities_before += entry(d).parent != d;
+            equalities_after += result[d - 1].parent != d;
         }
+        if (equalities_after == equalities_before) return false;
     }
-    return X4;
+
+    env = lhs.env;
+    entries = std::move(result);
+
+    return true;
 }
 
 // MARK: - Abstract Assignments
@@ -410,56 +392,164 @@ std::set<LinearEquality> NormalizedConjunction::computeX4(std::set<LinearEqualit
 /// [xi := ?]
 void NormalizedConjunction::nonDeterminsticAssignment(Value const* xi) {
     assert(xi != nullptr && "xi cannot be NULL");
-    auto xj = get(xi).x;
-    validVariables.insert(xi);
-    
-    if (xi != xj && xj != 0) {
-        get(xi) = {xi, 1, xi, 0};
-    } else {
-        // find all equations using xi
-        auto predicate = [&xi](std::pair<Value const*, LinearEquality> p){ return p.second.x == xi && p.second.y != xi ;};
-        auto it = std::find_if(values.begin(), values.end(), predicate);
-        if (it != values.end()) {
-            auto xk = (*it).second;
-            for (it = std::find_if(++it, values.end(), predicate);
-                 it != values.end();
-                 it = std::find_if(++it, values.end(), predicate)) {
-                auto& xl = it->second;
-                get(xl.y) = {xl.y, 1, xk.y, xl.b - xk.b};
-            }
-            get(xk.y) = {xk.y, 1, xk.y, 0};
-        }
-        get(xi) = {xi, 1, xi, 0};
+    int i = ensure(xi);
+    Entry& e = entry(i);
+
+    if (e.parent != i || e.next == i) {
+        // xi is a constant, a member of another class or alone in its class
+        unlink(i);
+        e = {i, 1, 0, i, i};
+        return;
     }
 
+    // xi is the representative of its class, so the member with the smallest dimension takes over.
+    // As the list starts at the representative, all other members follow in order of insertion.
+    std::vector<int> members;
+    for (int j = e.next; j != i; j = entry(j).next) {
+        members.push_back(j);
+    }
+    int k = *std::min_element(members.begin(), members.end());
+    // x_k = ak * xi + bk  =>  x_l = al / ak * x_k + (bl - al * bk / ak)
+    Number ak = entry(k).factor;
+    Number bk = entry(k).offset;
+
+    entry(k) = {k, 1, 0, k, k};
+    for (int l: members) {
+        if (l == k) continue;
+        Entry& el = entry(l);
+        Number factor = el.factor / ak;
+        Number offset = el.offset - el.factor * bk / ak;
+        if (factor.isInteger() && offset.isInteger()) {
+            el = {k, factor, offset, l, l};
+            link(l, k);
+        } else {
+            // Precison loss due to int division
+            el = {l, 1, 0, l, l};
+        }
+    }
+    entry(i) = {i, 1, 0, i, i};
 }
 
 /// [xi := a * xj + b]
-void NormalizedConjunction::linearAssignment(Value const* xi, int64_t a, Value const* xj, int64_t b) {
+void NormalizedConjunction::linearAssignment(Value const* xi, Number a, Value const* xj, Number b) {
     assert(xi != nullptr && "xi cannot be NULL");
 
+    if (xi == xj) {
+        // Only possible for weird phi nodes, we do not know anything afterwards
+        if (a != 1 || b != 0) nonDeterminsticAssignment(xi);
+        return;
+    }
+
     nonDeterminsticAssignment(xi);
-    validVariables.insert(xi);
+    int i = env->dimension(xi);
 
-    // make sure xj exists
-    auto xjS = values.find(xj) != values.end() ? get(xj).x : xj;
-    auto bS = values.find(xj) != values.end() ? get(xj).b : 0;
-    auto aS = values.find(xj) != values.end() ? get(xj).a : 1;
-    
-    if (!(a % aS == 0 && (-bS - b) % aS == 0)) {
-        // Precison loss due to int division! Abort
+    if (xj == nullptr || a == 0) {
+        entry(i) = {0, 1, b, i, i};
         return;
     }
-    
-    if (xi > xjS) {
-        get(xi) = {xi, aS * a, xjS, a * bS + b};
+
+    int j = ensure(xj);
+    Entry const& ej = entry(j);
+    if (ej.parent == 0) {
+        entry(i) = {0, 1, a * ej.offset + b, i, i};
         return;
-    } else {
-        auto pred = [&xjS](std::pair<Value const*, LinearEquality> p){ return p.second.x == xjS && p.second.y != xjS; };
-        for (auto xk: make_filter_range(values, pred)) {
-            get(xk.second.y) = {xk.second.y, xk.second.a * a/aS, xi, (-bS - b) / aS + xk.second.b};
+    }
+
+    // xi = A * r + B, with r the representative of xj
+    int r = ej.parent;
+    Number A = a * ej.factor;
+    Number B = a * ej.offset + b;
+
+    if (i > r) {
+        entry(i) = {r, A, B, i, i};
+        link(i, r);
+        return;
+    }
+
+    // xi becomes the new representative: r = (xi - B) / A, so x_l = al / A * xi + (bl - al * B / A)
+    std::vector<int> members = {r};
+    for (int l = entry(r).next; l != r; l = entry(l).next) {
+        members.push_back(l);
+    }
+    std::vector<std::pair<Number, Number>> coefficients;
+    for (int l: members) {
+        Entry const& el = entry(l);
+        Number factor = el.factor / A;
+        Number offset = el.offset - el.factor * B / A;
+        if (!factor.isInteger() || !offset.isInteger()) {
+            // Precison loss due to int division! Abort
+            return;
+        }
+        coefficients.push_back({factor, offset});
+    }
+    for (size_t m = 0; m < members.size(); m++) {
+        int l = members[m];
+        entry(l) = {i, coefficients[m].first, coefficients[m].second, l, l};
+        link(l, i);
+    }
+}
+
+// MARK: - Helpers
+
+int NormalizedConjunction::ensure(Value const* value) {
+    if (!env->contains(value)) {
+        env = DimensionEnvironment::extend(env, value);
+        int d = env->size();
+        entries.push_back({d, 1, 0, d, d});
+        assert(int(entries.size()) == d);
+    }
+    return env->dimension(value);
+}
+
+void NormalizedConjunction::unlink(int dim) {
+    Entry& e = entry(dim);
+    entry(e.prev).next = e.next;
+    entry(e.next).prev = e.prev;
+    e.prev = dim;
+    e.next = dim;
+}
+
+void NormalizedConjunction::link(int dim, int rep) {
+    Entry& e = entry(dim);
+    Entry& r = entry(rep);
+    e.prev = r.prev;
+    e.next = rep;
+    entry(r.prev).next = dim;
+    r.prev = dim;
+}
+
+void NormalizedConjunction::changeEnvironment(DimensionEnvironment::Ptr const& newEnv) {
+    if (env == newEnv) return;
+    assert(env->size() == newEnv->size() && newEnv->includes(*env));
+    if (*env == *newEnv) {
+        // Same variables in the same order, the entries stay as they are
+        env = newEnv;
+        return;
+    }
+
+    std::vector<int> position = {0};
+    for (Value const* variable: env->getVariables()) {
+        position.push_back(newEnv->dimension(variable));
+    }
+
+    std::vector<Entry> result(entries.size());
+    for (int d = 1; d <= env->size(); d++) {
+        Entry e = entry(d);
+        result[position[d] - 1] = {position[e.parent], e.factor, e.offset, position[e.prev], position[e.next]};
+    }
+
+    env = newEnv;
+    entries = std::move(result);
+}
+
+void NormalizedConjunction::adoptUnknownVariables(NormalizedConjunction const& other) {
+    for (Value const* variable: other.env->getVariables()) {
+        if (env->contains(variable)) continue;
+        LinearEquality eq = other[variable];
+        ensure(variable);
+        if (!eq.isTrivial()) {
+            linearAssignment(variable, eq.a, eq.x, eq.b);
         }
-        get(xjS) = {xjS, a/aS, xi, (-bS - b) / aS};
     }
 }
 
@@ -476,15 +566,15 @@ void NormalizedConjunction::Add(Instruction const& inst) {
     if (isa<ConstantInt>(op1) && (isa<ConstantInt>(op2))) {
         auto b1 = dyn_cast<ConstantInt>(op1);
         auto b2 = dyn_cast<ConstantInt>(op2);
-        return linearAssignment(&inst, 1, nullptr, b1->getSExtValue() + b2->getSExtValue() );
+        return linearAssignment(&inst, 1, nullptr, Number {b1->getValue()} + Number {b2->getValue()});
     // [xi := b + xj]
     }  else if (isa<ConstantInt>(op1) && isa<Value>(op2)) {
         auto b = dyn_cast<ConstantInt>(op1);
-        return linearAssignment(&inst, 1, op2, b->getSExtValue());
+        return linearAssignment(&inst, 1, op2, Number {b->getValue()});
     // [xi := xj + b]
     } else if (isa<ConstantInt>(op2) && isa<Value>(op1)) {
         auto b = dyn_cast<ConstantInt>(op2);
-        return linearAssignment(&inst, 1, op1, b->getSExtValue());
+        return linearAssignment(&inst, 1, op1, Number {b->getValue()});
     // [xi := xj + xk]
     } else if (isa<Value>(op1) && isa<Value>(op2)) {
         // [xi := bj + xk]
@@ -513,20 +603,20 @@ void NormalizedConjunction::Sub(Instruction const& inst) {
     if (isa<ConstantInt>(op1) && (isa<ConstantInt>(op2))) {
         auto b1 = dyn_cast<ConstantInt>(op1);
         auto b2 = dyn_cast<ConstantInt>(op2);
-        return linearAssignment(&inst, 1, nullptr, b1->getSExtValue() - b2->getSExtValue() );
+        return linearAssignment(&inst, 1, nullptr, Number {b1->getValue()} - Number {b2->getValue()});
     // [xi := b - xj]
     } else if (isa<ConstantInt>(op1) && isa<Value>(op2)) {
        auto b = dyn_cast<ConstantInt>(op1);
-       return linearAssignment(&inst, 1, op2, -b->getSExtValue());
+       return linearAssignment(&inst, -1, op2, Number {b->getValue()});
    // [xi := xj - b]
    } else if (isa<ConstantInt>(op2) && isa<Value>(op1)) {
        auto b = dyn_cast<ConstantInt>(op2);
-       return linearAssignment(&inst, 1, op1, -b->getSExtValue());
+       return linearAssignment(&inst, 1, op1, -Number {b->getValue()});
    // [xi := xj - xk]
    } else if (isa<Value>(op1) && isa<Value>(op2)) {
        // [xi := bj - xk]
        if (get(op1).isConstant()) {
-           return linearAssignment(&inst, 1, op2, -get(op1).b);
+           return linearAssignment(&inst, -1, op2, get(op1).b);
        // [xi := xj - bk]
        } else if (get(op2).isConstant()) {
            return linearAssignment(&inst, 1, op1, -get(op2).b);
@@ -549,11 +639,11 @@ void NormalizedConjunction::Mul(Instruction const& inst) {
     if (isa<ConstantInt>(op1) && (isa<ConstantInt>(op2))) {
         auto b1 = dyn_cast<ConstantInt>(op1);
         auto b2 = dyn_cast<ConstantInt>(op2);
-        return linearAssignment(&inst, 1, nullptr, b1->getSExtValue() * b2->getSExtValue() );
+        return linearAssignment(&inst, 1, nullptr, Number {b1->getValue()} * Number {b2->getValue()});
     // [xi := a * xj]
     } else if (isa<ConstantInt>(op1) && isa<Value>(op2)) {
         auto a = dyn_cast<ConstantInt>(op1);
-        int64_t a_val = a->getSExtValue();
+        Number a_val {a->getValue()};
         if (a_val == 0) {
             return linearAssignment(&inst, 1, nullptr, 0);
         } else {
@@ -562,11 +652,11 @@ void NormalizedConjunction::Mul(Instruction const& inst) {
     // [xi := xj * a]
     } else if (isa<ConstantInt>(op2) && isa<Value>(op1)) {
         auto a = dyn_cast<ConstantInt>(op2);
-        int64_t a_val = a->getSExtValue();
+        Number a_val {a->getValue()};
         if (a_val == 0) {
             return linearAssignment(&inst, 1, nullptr, 0);
         } else {
-            return linearAssignment(&inst, a_val, op2, 0);
+            return linearAssignment(&inst, a_val, op1, 0);
         }
     // [xi := xj * xk]
     } else if (isa<Value>(op1) && isa<Value>(op2)) {
@@ -596,22 +686,52 @@ void NormalizedConjunction::Mul(Instruction const& inst) {
 
 // MARK: - Operators
 
-LinearEquality& NormalizedConjunction::operator[](Value const* value) {
+bool NormalizedConjunction::operator==(NormalizedConjunction const& other) const {
+    if (isBottom != other.isBottom) return false;
+
+    if (env == other.env || *env == *other.env) {
+        for (int d = 1; d <= env->size(); d++) {
+            Entry const& e1 = entry(d);
+            Entry const& e2 = other.entry(d);
+            if (e1.parent != e2.parent || e1.factor != e2.factor || e1.offset != e2.offset) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    return env->size() == other.env->size() && env->includes(*other.env) && equalities() == other.equalities();
+}
+
+LinearEquality NormalizedConjunction::operator[](Value const* value) const {
     return get(value);
 }
 
-LinearEquality& NormalizedConjunction::get(Value const* value) {
-    if (values.count(value) == 0) {
-        LinearEquality eq = {value, 1, value, 0};
-        values[value] = eq;
+LinearEquality NormalizedConjunction::get(Value const* value) const {
+    if (!env->contains(value)) {
+        return {value, 1, value, 0};
+    }
+    Entry const& e = entry(env->dimension(value));
+    if (e.parent == 0) {
+        return {value, 1, nullptr, e.offset};
+    }
+    return {value, e.factor, env->variable(e.parent), e.offset};
+}
+
+std::unordered_map<Value const*, LinearEquality> NormalizedConjunction::equalities() const {
+    std::unordered_map<Value const*, LinearEquality> result;
+    for (int d = 1; d <= env->size(); d++) {
+        if (entry(d).parent == d) continue;
+        Value const* variable = env->variable(d);
+        result[variable] = get(variable);
     }
-    return values[value];
+    return result;
 }
 
 // MARK: - Debug
 
 void NormalizedConjunction::debug_output(Instruction const& inst, std::vector<LinearEquality> operands) {
-    dbgs(3).indent(2) << inst << " // " << values.at(&inst) << ", args ";
+    dbgs(3).indent(2) << inst << " // " << get(&inst) << ", args ";
     {int i = 0;
     for (Value const* value: inst.operand_values()) {
         if (i) dbgs(3) << ", ";
@@ -625,18 +745,18 @@ void NormalizedConjunction::debug_output(Instruction const& inst, std::vector<Li
 void NormalizedConjunction::printIncoming(BasicBlock const& bb, raw_ostream& out, int indentation = 0) const {
     // @Speed: This is quadratic, could be linear
     bool nothing = true;
-    for (std::pair<Value const*, LinearEquality> const& i: values) {
+    for (Value const* variable: env->getVariables()) {
         bool read    = false;
         bool written = false;
         for (Instruction const& inst: bb) {
-            if (&inst == i.first) written = true;
+            if (&inst == variable) written = true;
             for (Value const* v: inst.operand_values()) {
-                if (v == i.first) read = true;
+                if (v == variable) read = true;
             }
         }
 
         if (read and not written) {
-            out.indent(indentation) << '%' << i.first->getName() << " = " << i.second << '\n';
+            out.indent(indentation) << '%' << variable->getName() << " = " << get(variable) << '\n';
             nothing = false;
         }
     }
@@ -648,13 +768,14 @@ void NormalizedConjunction::printIncoming(BasicBlock const& bb, raw_ostream& out
 
 void NormalizedConjunction::printOutgoing(BasicBlock const& bb, raw_ostream& out, int indentation = 0) const {
     int nrOfNonTrivialEquations = 0;
-    for (auto const& i: values) {
-        if (ReturnInst::classof(i.first)) {
-            out.indent(indentation) << "<ret> = " << i.second << '\n';
+    for (Value const* variable: env->getVariables()) {
+        LinearEquality eq = get(variable);
+        if (ReturnInst::classof(variable)) {
+            out.indent(indentation) << "<ret> = " << eq << '\n';
         } else {
-            out.indent(indentation) << '%' << i.first->getName() << " = " << i.second << '\n';
+            out.indent(indentation) << '%' << variable->getName() << " = " << eq << '\n';
         }
-        nrOfNonTrivialEquations += !i.second.isTrivial();
+        nrOfNonTrivialEquations += !eq.isTrivial();
     }
     out.indent(indentation) << nrOfNonTrivialEquations << " non-trivial equations\n";
 }
@@ -7,25 +7,43 @@
 
 #pragma once
 
+#include <functional>
 #include <unordered_map>
 #include <vector>
-#include <set>
 
 #include <llvm/IR/Instructions.h>
 
 #include "global.h"
+#include "dimension_environment.h"
 #include "linear_equality.h"
+#include "number.h"
 
 namespace pcpo {
 
 class NormalizedConjunction {
 public:
-    std::unordered_map<llvm::Value const*, LinearEquality> values;
-    std::set<llvm::Value const*> validVariables;
+    /// Equality x_d = factor * x_parent + offset of the variable with dimension d. Representatives
+    /// have parent == d, constants have parent == 0. The representative of a class is always the
+    /// member with the smallest dimension, which keeps the representation canonical. The members
+    /// of a class are linked in a circular list through prev and next, so a class can be visited
+    /// without looking at any other variable.
+    struct Entry {
+        int parent;
+        Number factor;
+        Number offset;
+        int prev;
+        int next;
+    };
+
+    /// Variables that have been assigned in this state. Their dimension d is the index of their
+    /// entry, i.e. `entries[d - 1]`.
+    DimensionEnvironment::Ptr env = DimensionEnvironment::empty();
+    std::vector<Entry> entries;
     bool isBottom = true;
     
     NormalizedConjunction() = default;
     NormalizedConjunction(NormalizedConjunction const& state) = default;
+    /// Applies the equalities as assignments, in the order of their left hand side.
     NormalizedConjunction(std::unordered_map<llvm::Value const*, LinearEquality> const& equalaties);
     
     explicit NormalizedConjunction(llvm::Function const& f);
@@ -45,6 +63,9 @@ public:
     bool merge(Merge_op::Type op, NormalizedConjunction const& other);
     void branch(llvm::BasicBlock const& from, llvm::BasicBlock const& towards) { return; };
     bool leastUpperBound(NormalizedConjunction rhs);
+    /// Forgets the variables for which `keep` returns false. The equalities between the remaining
+    /// variables are kept, classes whose representative is forgotten get a new one.
+    void project(std::function<bool(llvm::Value const*)> const& keep);
 
     bool checkOperandsForBottom(llvm::Instruction const& inst) { return false; }
     
@@ -52,12 +73,18 @@ public:
     void printOutgoing(llvm::BasicBlock const& bb, llvm::raw_ostream& out, int indentation) const;
     
     // Abstract Assignments
-    void linearAssignment(llvm::Value const* xi, int64_t a, llvm::Value const* xj, int64_t b);
+    void linearAssignment(llvm::Value const* xi, Number a, llvm::Value const* xj, Number b);
     void nonDeterminsticAssignment(llvm::Value const* xi);
 
+    /// All non-trivial equalities, i.e. those of the variables that are not a representative.
+    std::unordered_map<llvm::Value const*, LinearEquality> equalities() const;
+
     // Operators
-    LinearEquality& operator[](llvm::Value const*);
-    LinearEquality& get(llvm::Value const*);
+    bool operator==(NormalizedConjunction const& other) const;
+    bool operator!=(NormalizedConjunction const& other) const { return !(*this == other); };
+    LinearEquality operator[](llvm::Value const*) const;
+    /// Equality of `value` in terms of its representative, trivial for unknown values.
+    LinearEquality get(llvm::Value const*) const;
     
 protected:
     // Abstract Operators
@@ -69,10 +96,20 @@ protected:
     void debug_output(llvm::Instruction const& inst, std::vector<LinearEquality> operands);
     
     // Helpers
-    static std::set<LinearEquality> computeX0(std::set<LinearEquality> const& E1, std::set<LinearEquality> const& E2);
-    static std::set<LinearEquality> computeX1(std::set<LinearEquality> const& E1, std::set<LinearEquality> const& E2);
-    static std::set<LinearEquality> computeX2(std::set<LinearEquality> const& E1, std::set<LinearEquality> const& E2);
-    static std::set<LinearEquality> computeX4(std::set<LinearEquality> const& E1, std::set<LinearEquality> const& E2);
+    Entry& entry(int dim) { return entries[dim - 1]; };
+    Entry const& entry(int dim) const { return entries[dim - 1]; };
+    /// Adds `value` as the representative of a new class, unless it is part of the state already.
+    /// Returns its dimension.
+    int ensure(llvm::Value const* value);
+    /// Removes the variable from the member list of its class.
+    void unlink(int dim);
+    /// Appends the variable to the member list of the class of `rep`.
+    void link(int dim, int rep);
+    /// Reorders the entries for `newEnv`, which has to contain exactly the same variables. The
+    /// representatives are kept, so the state is only normalised again by the next join.
+    void changeEnvironment(DimensionEnvironment::Ptr const& newEnv);
+    /// Assigns every variable that is only known to `other` its equality from `other`.
+    void adoptUnknownVariables(NormalizedConjunction const& other);
 };
 
 
@@ -0,0 +1,138 @@
+#include "number.h"
+
+#include <algorithm>
+
+using namespace llvm;
+
+namespace pcpo {
+
+// MARK: - Initializers
+
+Number::Number(APInt const& value) {
+    if (value.getMinSignedBits() <= 64) {
+        this->value = value.getSExtValue();
+    } else {
+        *this = normalize(value, APInt {value.getBitWidth(), 1});
+    }
+}
+
+// MARK: - Accessors
+
+APInt Number::numerator() const {
+    return rational().numerator;
+}
+
+APInt Number::denominator() const {
+    return rational().denominator;
+}
+
+int Number::sign() const {
+    if (isSmall()) return (value > 0) - (value < 0);
+    return big->rational.numerator.isNegative() ? -1 : 1;
+}
+
+// MARK: - Slow paths
+
+Number::Rational Number::rational() const {
+    if (isSmall()) return {APInt {64, uint64_t(value), true}, APInt {64, 1}};
+    return big->rational;
+}
+
+Number Number::normalize(APInt numerator, APInt denominator) {
+    assert(denominator != 0 && "division by zero");
+    // One more bit, so that negating and taking the absolute value cannot overflow
+    unsigned width = std::max(numerator.getBitWidth(), denominator.getBitWidth()) + 1;
+    numerator = numerator.sext(width);
+    denominator = denominator.sext(width);
+    if (denominator.isNegative()) {
+        numerator.negate();
+        denominator.negate();
+    }
+
+    APInt gcd = APIntOps::GreatestCommonDivisor(numerator.abs(), denominator);
+    if (gcd != 1) {
+        numerator = numerator.sdiv(gcd);
+        denominator = denominator.sdiv(gcd);
+    }
+
+    if (denominator == 1 && numerator.getMinSignedBits() <= 64) {
+        return Number {numerator.getSExtValue()};
+    }
+
+    width = std::max(numerator.getMinSignedBits(), denominator.getMinSignedBits());
+    Number result;
+    result.big = new Shared {{numerator.sextOrTrunc(width), denominator.sextOrTrunc(width)}};
+    return result;
+}
+
+namespace {
+
+/// Sign extends all values to a common width, that is large enough for the product of any two of
+/// them, plus a carry.
+void extend(std::initializer_list<APInt*> values) {
+    unsigned width = 0;
+    for (APInt* value: values) width = std::max(width, value->getBitWidth());
+    for (APInt* value: values) *value = value->sext(2 * width + 1);
+}
+
+}
+
+Number Number::add(Number const& lhs, Number const& rhs) {
+    Rational a = lhs.rational();
+    Rational b = rhs.rational();
+    extend({&a.numerator, &a.denominator, &b.numerator, &b.denominator});
+    return normalize(a.numerator * b.denominator + b.numerator * a.denominator, a.denominator * b.denominator);
+}
+
+Number Number::mul(Number const& lhs, Number const& rhs) {
+    Rational a = lhs.rational();
+    Rational b = rhs.rational();
+    extend({&a.numerator, &a.denominator, &b.numerator, &b.denominator});
+    return normalize(a.numerator * b.numerator, a.denominator * b.denominator);
+}
+
+Number Number::div(Number const& lhs, Number const& rhs) {
+    Rational a = lhs.rational();
+    Rational b = rhs.rational();
+    extend({&a.numerator, &a.denominator, &b.numerator, &b.denominator});
+    return normalize(a.numerator * b.denominator, a.denominator * b.numerator);
+}
+
+int Number::compare(Number const& lhs, Number const& rhs) {
+    Rational a = lhs.rational();
+    Rational b = rhs.rational();
+    extend({&a.numerator, &a.denominator, &b.numerator, &b.denominator});
+    // The denominators are positive
+    APInt left = a.numerator * b.denominator;
+    APInt right = b.numerator * a.denominator;
+    return left.slt(right) ? -1 : left == right ? 0 : 1;
+}
+
+bool Number::equal(Number const& lhs, Number const& rhs) {
+    Rational const& a = lhs.big->rational;
+    Rational const& b = rhs.big->rational;
+    // Canonical fractions of the same value have the same bit width
+    return a.numerator.getBitWidth() == b.numerator.getBitWidth()
+        && a.numerator == b.numerator && a.denominator == b.denominator;
+}
+
+// MARK: - Operators
+
+hash_code Number::hashRational(Number const& number) {
+    return hash_combine(number.big->rational.numerator, number.big->rational.denominator);
+}
+
+raw_ostream& operator<<(raw_ostream& os, Number const& number) {
+    if (number.isSmall()) {
+        os << number.getInt64();
+    } else {
+        number.numerator().print(os, true);
+        if (!number.isInteger()) {
+            os << '/';
+            number.denominator().print(os, false);
+        }
+    }
+    return os;
+}
+
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#include <llvm/ADT/APInt.h>
+#include <llvm/ADT/Hashing.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace pcpo {
+
+/// Exact rational number for the coefficients of relational domains. Values that are integers and
+/// fit into an int64_t are stored as such, and all operations on them use the overflow checking
+/// builtins. Only if a result overflows or is not integral, the number is promoted to a fraction of
+/// arbitrary precision APInts. The representation is canonical, so equal numbers have equal
+/// representations (and hashes), and a promoted number is never a small integer.
+///
+/// A promoted value lives on the heap and is shared by the copies of the number, with a reference
+/// count. It is freed together with the last of them, so there is no global state. Copying a small
+/// number only has to check that there is nothing to share.
+class Number {
+public:
+    Number() = default;
+    Number(int64_t value): value{value} {};
+    Number(Number const& other): value{other.value}, big{other.big} { retain(); };
+    Number(Number&& other): value{other.value}, big{other.big} { other.big = nullptr; };
+    ~Number() { release(); };
+    Number& operator=(Number const& other) {
+        // Retained first, in case other is this number
+        other.retain();
+        release();
+        value = other.value;
+        big = other.big;
+        return *this;
+    };
+    Number& operator=(Number&& other) {
+        std::swap(value, other.value);
+        std::swap(big, other.big);
+        return *this;
+    };
+    /// Signed interpretation of `value`, of any bit width.
+    explicit Number(llvm::APInt const& value);
+
+    /// Whether the number is an integer stored in an int64_t, i.e. whether the fast path is taken.
+    bool isSmall() const { return big == nullptr; };
+    bool isInteger() const { return isSmall() || big->rational.denominator == 1; };
+    /// Value of a small number.
+    int64_t getInt64() const { assert(isSmall()); return value; };
+    /// Numerator and denominator of the reduced fraction, the denominator is always positive.
+    llvm::APInt numerator() const;
+    llvm::APInt denominator() const;
+    /// -1, 0 or 1
+    int sign() const;
+
+    // The binary operators are friends, so that both sides convert from integers
+    Number operator-() const;
+    friend Number operator+(Number const& lhs, Number const& rhs);
+    friend Number operator-(Number const& lhs, Number const& rhs);
+    friend Number operator*(Number const& lhs, Number const& rhs);
+    /// Exact division, the result is a fraction if rhs does not divide lhs. rhs must not be 0.
+    friend Number operator/(Number const& lhs, Number const& rhs);
+
+    Number& operator+=(Number const& rhs) { return *this = *this + rhs; };
+    Number& operator-=(Number const& rhs) { return *this = *this - rhs; };
+    Number& operator*=(Number const& rhs) { return *this = *this * rhs; };
+    Number& operator/=(Number const& rhs) { return *this = *this / rhs; };
+
+    friend bool operator==(Number const& lhs, Number const& rhs);
+    friend bool operator!=(Number const& lhs, Number const& rhs) { return !(lhs == rhs); };
+    friend bool operator<(Number const& lhs, Number const& rhs);
+    friend bool operator>(Number const& lhs, Number const& rhs) { return rhs < lhs; };
+    friend bool operator<=(Number const& lhs, Number const& rhs) { return !(rhs < lhs); };
+    friend bool operator>=(Number const& lhs, Number const& rhs) { return !(lhs < rhs); };
+
+    friend llvm::hash_code hash_value(Number const& number) {
+        return number.isSmall() ? llvm::hash_value(number.value) : hashRational(number);
+    };
+
+private:
+    struct Rational {
+        llvm::APInt numerator;
+        llvm::APInt denominator;
+    };
+    /// Promoted value, shared by the copies of a number
+    struct Shared {
+        Rational rational;
+        mutable std::atomic<unsigned> references {1};
+    };
+
+    int64_t value = 0;
+    // Only set if the number is not a small integer
+    Shared const* big = nullptr;
+
+    void retain() const {
+        if (big) big->references.fetch_add(1, std::memory_order_relaxed);
+    };
+    void release() const {
+        if (big && big->references.fetch_sub(1, std::memory_order_acq_rel) == 1) delete big;
+    };
+
+    Rational rational() const;
+    /// Reduces the fraction and returns its canonical representation.
+    static Number normalize(llvm::APInt numerator, llvm::APInt denominator);
+
+    // Out of line slow paths, operating on fractions
+    static Number add(Number const& lhs, Number const& rhs);
+    static Number mul(Number const& lhs, Number const& rhs);
+    static Number div(Number const& lhs, Number const& rhs);
+    static int compare(Number const& lhs, Number const& rhs);
+    static bool equal(Number const& lhs, Number const& rhs);
+    static llvm::hash_code hashRational(Number const& number);
+};
+
+llvm::raw_ostream& operator<<(llvm::raw_ostream& os, Number const& number);
+
+// MARK: - Fast paths
+
+inline Number Number::operator-() const {
+    if (isSmall() && value != std::numeric_limits<int64_t>::min()) return -value;
+    return mul(*this, -1);
+}
+
+inline Number operator+(Number const& lhs, Number const& rhs) {
+    int64_t result;
+    if (lhs.isSmall() && rhs.isSmall() && !__builtin_add_overflow(lhs.value, rhs.value, &result)) return result;
+    return Number::add(lhs, rhs);
+}
+
+inline Number operator-(Number const& lhs, Number const& rhs) {
+    int64_t result;
+    if (lhs.isSmall() && rhs.isSmall() && !__builtin_sub_overflow(lhs.value, rhs.value, &result)) return result;
+    return Number::add(lhs, -rhs);
+}
+
+inline Number operator*(Number const& lhs, Number const& rhs) {
+    int64_t result;
+    if (lhs.isSmall() && rhs.isSmall() && !__builtin_mul_overflow(lhs.value, rhs.value, &result)) return result;
+    return Number::mul(lhs, rhs);
+}
+
+inline Number operator/(Number const& lhs, Number const& rhs) {
+    assert(rhs != 0 && "division by zero");
+    if (lhs.isSmall() && rhs.isSmall()) {
+        // INT64_MIN / -1 overflows, and so does INT64_MIN % -1
+        if (rhs.value == -1 && lhs.value != std::numeric_limits<int64_t>::min()) return -lhs.value;
+        if (rhs.value != -1 && lhs.value % rhs.value == 0) return lhs.value / rhs.value;
+    }
+    return Number::div(lhs, rhs);
+}
+
+inline bool operator==(Number const& lhs, Number const& rhs) {
+    // A promoted number never equals a small one
+    if (lhs.isSmall() || rhs.isSmall()) return lhs.value == rhs.value && lhs.big == rhs.big;
+    return lhs.big == rhs.big || Number::equal(lhs, rhs);
+}
+
+inline bool operator<(Number const& lhs, Number const& rhs) {
+    if (lhs.isSmall() && rhs.isSmall()) return lhs.value < rhs.value;
+    return Number::compare(lhs, rhs) < 0;
+}
+
+}
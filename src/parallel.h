@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <llvm/Support/raw_ostream.h>
+
+#include "global.h"
+
+namespace pcpo {
+
+/// Runs task(0), ..., task(count - 1) on up to threads threads, or on all
+/// cores if threads is 0. The debug output of each task is buffered and
+/// printed in order afterwards, so that it does not interleave.
+template <typename Task>
+void run_parallel(size_t count, unsigned threads, Task task) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  if (threads == 1 || count <= 1) {
+    for (size_t i = 0; i < count; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  std::vector<std::string> output(count);
+  std::atomic<size_t> next = {0};
+  auto worker = [&]() {
+    for (size_t i = next++; i < count; i = next++) {
+      llvm::raw_string_ostream stream{output[i]};
+      debug_stream = &stream;
+      task(i);
+      debug_stream = nullptr;
+      stream.flush();
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned i = 0; i < std::min<size_t>(threads, count); ++i) {
+    pool.emplace_back(worker);
+  }
+  for (std::thread &thread : pool) {
+    thread.join();
+  }
+  // The caller may itself be a task whose output is buffered
+  llvm::raw_ostream &out = debug_stream ? *debug_stream : llvm::errs();
+  for (std::string const &text : output) {
+    out << text;
+  }
+}
+
+} // namespace pcpo
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <vector>
+
+#include "llvm/IR/CFG.h"
+#include <llvm/IR/InstrTypes.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/MDBuilder.h>
+
+#include "global.h"
+#include "simple_interval.h"
+#include "value_set.h"
+
+namespace pcpo {
+
+/// Interval analysis whose results are written back into the IR, so that later
+/// passes can use them: integer loads and calls get !range metadata, and add,
+/// sub and mul get nsw/nuw if their operands cannot wrap.
+class RangeAnnotation : public AbstractStateValueSet<SimpleInterval> {
+public:
+  using AbstractStateValueSet<SimpleInterval>::AbstractStateValueSet;
+
+  void applyPHINode(llvm::BasicBlock const &bb,
+                    std::vector<RangeAnnotation> const &pred_values,
+                    llvm::Instruction const &inst) {
+    std::vector<AbstractStateValueSet<SimpleInterval>> preds(
+        pred_values.begin(), pred_values.end());
+    AbstractStateValueSet<SimpleInterval>::applyPHINode(bb, preds, inst);
+  }
+
+  /// Annotates function, where state_of(bb) is the outgoing state of bb,
+  /// joined over all contexts. Existing metadata and flags are kept. Returns
+  /// whether the function changed.
+  template <typename StateOf>
+  static bool transformFunction(llvm::Function &function,
+                                StateOf const &state_of) {
+    bool hasChanged = false;
+
+    for (llvm::BasicBlock &bb : function) {
+      RangeAnnotation const &state = state_of(&bb);
+      if (state.isBottom)
+        continue;
+
+      for (llvm::Instruction &inst : bb) {
+        if (isa<llvm::LoadInst>(inst) || isa<llvm::CallInst>(inst)) {
+          hasChanged |= state.annotateRange(inst);
+        } else if (auto op = dyn_cast<llvm::BinaryOperator>(&inst)) {
+          hasChanged |= state.annotateWrap(*op);
+        }
+      }
+    }
+
+    return hasChanged;
+  }
+
+private:
+  /// Attaches !range to inst. Phis would benefit as well, but the verifier
+  /// only allows it on loads, calls and invokes.
+  bool annotateRange(llvm::Instruction &inst) const {
+    if (!inst.getType()->isIntegerTy() ||
+        inst.getMetadata(llvm::LLVMContext::MD_range))
+      return false;
+
+    SimpleInterval interval = getAbstractValue(inst);
+    // A range has to be non-empty and must not contain every value
+    if (interval.state != SimpleInterval::NORMAL ||
+        interval.begin == interval.end + 1)
+      return false;
+
+    llvm::MDBuilder builder{inst.getContext()};
+    inst.setMetadata(llvm::LLVMContext::MD_range,
+                     builder.createRange(interval.begin, interval.end + 1));
+    dbgs(3) << "  Range of" << inst << " is " << interval << '\n';
+    return true;
+  }
+
+  bool annotateWrap(llvm::BinaryOperator &op) const {
+    unsigned opcode = op.getOpcode();
+    if (opcode != llvm::Instruction::Add && opcode != llvm::Instruction::Sub &&
+        opcode != llvm::Instruction::Mul)
+      return false;
+
+    SimpleInterval a = getAbstractValue(*op.getOperand(0));
+    SimpleInterval b = getAbstractValue(*op.getOperand(1));
+    if (a.state != SimpleInterval::NORMAL || b.state != SimpleInterval::NORMAL)
+      return false;
+
+    bool hasChanged = false;
+    if (!op.hasNoUnsignedWrap() && noUnsignedWrap(opcode, a, b)) {
+      op.setHasNoUnsignedWrap(true);
+      hasChanged = true;
+    }
+    if (!op.hasNoSignedWrap() && noSignedWrap(opcode, a, b)) {
+      op.setHasNoSignedWrap(true);
+      hasChanged = true;
+    }
+    return hasChanged;
+  }
+
+public:
+  /// Whether a opcode b cannot wrap around as unsigned (respectively signed)
+  /// numbers, for all values of the intervals. opcode is add, sub or mul.
+  static bool noUnsignedWrap(unsigned opcode, SimpleInterval const &a,
+                             SimpleInterval const &b) {
+    // Only the overflow flags of the *_ov calls are used, not their results
+    bool overflow = false;
+    switch (opcode) {
+    case llvm::Instruction::Add:
+      (void)a._umax().uadd_ov(b._umax(), overflow);
+      return !overflow;
+    case llvm::Instruction::Sub:
+      return a._umin().uge(b._umax());
+    case llvm::Instruction::Mul:
+      (void)a._umax().umul_ov(b._umax(), overflow);
+      return !overflow;
+    }
+    return false;
+  }
+
+  static bool noSignedWrap(unsigned opcode, SimpleInterval const &a,
+                           SimpleInterval const &b) {
+    // The extreme results are reached at the bounds of the operands. As above,
+    // only the overflow flags are used.
+    bool overflow = false;
+    bool any = false;
+    switch (opcode) {
+    case llvm::Instruction::Add:
+      (void)a._smax().sadd_ov(b._smax(), overflow);
+      any |= overflow;
+      (void)a._smin().sadd_ov(b._smin(), overflow);
+      return !(any | overflow);
+    case llvm::Instruction::Sub:
+      (void)a._smax().ssub_ov(b._smin(), overflow);
+      any |= overflow;
+      (void)a._smin().ssub_ov(b._smax(), overflow);
+      return !(any | overflow);
+    case llvm::Instruction::Mul:
+      for (llvm::APInt const &x : {a._smin(), a._smax()}) {
+        for (llvm::APInt const &y : {b._smin(), b._smax()}) {
+          (void)x.smul_ov(y, overflow);
+          any |= overflow;
+        }
+      }
+      return !any;
+    }
+    return false;
+  }
+};
+
+} // namespace pcpo
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Transforms/Utils/Local.h>
+
+#include "global.h"
+#include "normalized_conjunction.h"
+
+namespace pcpo {
+
+/// Analysis of linear equalities y = a * x + b whose results are used to
+/// remove redundant computations:
+///  - A value that equals a constant becomes that constant.
+///  - A value that equals another value that dominates it, e.g. its
+///    representative with a = 1 and b = 0, is replaced by that value.
+///  - A multiplication y = a * x + b becomes z + (b - c) if a dominating value
+///    z = a * x + c is available.
+/// The equalities hold modulo the bit width of the values, as add, sub and
+/// mul wrap around, so only integral factors and offsets are used.
+class RedundancyElimination : public NormalizedConjunction {
+public:
+  using NormalizedConjunction::NormalizedConjunction;
+
+  void applyPHINode(llvm::BasicBlock const &bb,
+                    std::vector<RedundancyElimination> const &pred_values,
+                    llvm::Instruction const &inst) {
+    std::vector<NormalizedConjunction> preds(pred_values.begin(),
+                                             pred_values.end());
+    NormalizedConjunction::applyPHINode(bb, preds, inst);
+  }
+
+  /// Keeps every variable, as values that dominate a block can replace its
+  /// instructions even where they are no longer live
+  void project(std::function<bool(llvm::Value const *)> const &keep) {}
+
+  /// Removes the redundant computations of function, where state_of(bb) is
+  /// the outgoing state of bb, joined over all contexts. Returns whether the
+  /// function changed.
+  template <typename StateOf>
+  static bool transformFunction(llvm::Function &function,
+                                StateOf const &state_of) {
+    // The values of function in program order, which is the order in which
+    // the members of a class are tried
+    std::vector<llvm::Value *> values;
+    std::unordered_map<llvm::Value const *, unsigned> order;
+    for (llvm::Argument &arg : function.args()) {
+      order[&arg] = values.size();
+      values.push_back(&arg);
+    }
+    for (llvm::BasicBlock &bb : function) {
+      for (llvm::Instruction &inst : bb) {
+        order[&inst] = values.size();
+        values.push_back(&inst);
+      }
+    }
+
+    llvm::DominatorTree dominators{function};
+    std::unordered_set<llvm::Value *> replaced;
+    std::vector<llvm::Instruction *> erase;
+
+    for (llvm::BasicBlock &bb : function) {
+      RedundancyElimination const &state = state_of(&bb);
+      if (state.isBottom)
+        continue;
+
+      // The members of each class of this function, keyed by representative
+      std::unordered_map<llvm::Value const *, std::vector<unsigned>> classes;
+      for (auto const &[variable, equality] : state.equalities()) {
+        if (equality.x && order.count(variable)) {
+          classes[equality.x].push_back(order.at(variable));
+        }
+      }
+      for (auto &[representative, members] : classes) {
+        if (order.count(representative)) {
+          members.push_back(order.at(representative));
+        }
+        std::sort(members.begin(), members.end());
+      }
+
+      for (llvm::Instruction &inst : bb) {
+        if (!inst.getType()->isIntegerTy() || inst.use_empty())
+          continue;
+        llvm::Value *replacement =
+            state.findReplacement(inst, classes, values, replaced, dominators);
+        if (!replacement)
+          continue;
+
+        dbgs(3) << "  Replaced" << inst << " by" << *replacement << '\n';
+        if (isa<llvm::Instruction>(replacement) && !order.count(replacement)) {
+          replacement->takeName(&inst);
+        }
+        inst.replaceAllUsesWith(replacement);
+        replaced.insert(&inst);
+        if (llvm::isInstructionTriviallyDead(&inst)) {
+          erase.push_back(&inst);
+        }
+      }
+    }
+
+    for (llvm::Instruction *inst : erase) {
+      inst->eraseFromParent();
+    }
+    return !replaced.empty();
+  }
+
+private:
+  static llvm::ConstantInt *toConstant(llvm::Type *type, Number const &number) {
+    unsigned width = type->getIntegerBitWidth();
+    return llvm::ConstantInt::get(type->getContext(),
+                                  number.numerator().sextOrTrunc(width));
+  }
+
+  /// Whether z is available wherever inst is
+  static bool dominates(llvm::Value const *z, llvm::Instruction const &inst,
+                        llvm::DominatorTree const &dominators) {
+    auto def = dyn_cast<llvm::Instruction>(z);
+    if (!def)
+      return true;
+    // Phis of the same block are evaluated simultaneously
+    if (isa<llvm::PHINode>(def) && isa<llvm::PHINode>(inst) &&
+        def->getParent() == inst.getParent())
+      return true;
+    return dominators.dominates(def, &inst);
+  }
+
+  /// The value that inst can be replaced by, inserted before inst if it is a
+  /// new instruction, or nullptr if there is none
+  llvm::Value *findReplacement(
+      llvm::Instruction &inst,
+      std::unordered_map<llvm::Value const *, std::vector<unsigned>> const
+          &classes,
+      std::vector<llvm::Value *> const &values,
+      std::unordered_set<llvm::Value *> const &replaced,
+      llvm::DominatorTree const &dominators) const {
+    LinearEquality equality = get(&inst);
+    if (!equality.a.isInteger() || !equality.b.isInteger())
+      return nullptr;
+    if (!equality.x)
+      return toConstant(inst.getType(), equality.b);
+
+    auto it = classes.find(equality.x);
+    if (it == classes.end())
+      return nullptr;
+
+    // The first dominating value with the same factor, for multiplications
+    llvm::Value *base = nullptr;
+    Number base_offset = 0;
+    for (unsigned index : it->second) {
+      llvm::Value *z = values[index];
+      if (z == &inst || z->getType() != inst.getType() || replaced.count(z) ||
+          !dominates(z, inst, dominators))
+        continue;
+      LinearEquality other = get(z);
+      if (other.a != equality.a || !other.b.isInteger())
+        continue;
+      if (other.b == equality.b)
+        return z;
+      if (!base) {
+        base = z;
+        base_offset = other.b;
+      }
+    }
+
+    if (!base || inst.getOpcode() != llvm::Instruction::Mul)
+      return nullptr;
+    return llvm::BinaryOperator::CreateAdd(
+        base, toConstant(inst.getType(), equality.b - base_offset), "", &inst);
+  }
+};
+
+} // namespace pcpo
@@ -0,0 +1,64 @@
+#include "registry.h"
+
+#include <map>
+#include <set>
+#include <utility>
+
+namespace pcpo {
+
+using namespace llvm;
+
+namespace {
+
+using Analyses =
+    std::map<std::pair<std::string, std::string>, AnalysisFunction>;
+
+// Filled while the static registrations are initialized, so this must not be a
+// global itself
+Analyses &analyses() {
+  static Analyses analyses;
+  return analyses;
+}
+
+} // namespace
+
+AnalysisRegistration::AnalysisRegistration(char const *domain,
+                                           char const *engine,
+                                           AnalysisFunction analysis) {
+  analyses()[{domain, engine}] = analysis;
+}
+
+AnalysisFunction find_analysis(std::string const &domain,
+                               std::string const &engine) {
+  auto it = analyses().find({domain, engine});
+  return it != analyses().end() ? it->second : nullptr;
+}
+
+std::vector<std::string> registered_domains() {
+  std::set<std::string> domains;
+  for (auto const &[key, analysis] : analyses()) {
+    domains.insert(key.first);
+  }
+  return {domains.begin(), domains.end()};
+}
+
+std::vector<std::string> registered_engines() {
+  std::set<std::string> engines;
+  for (auto const &[key, analysis] : analyses()) {
+    engines.insert(key.second);
+  }
+  return {engines.begin(), engines.end()};
+}
+
+bool analyze_module(Module const &module, std::string const &domain,
+                    std::string const &engine, raw_ostream &out,
+                    AnalysisStatistics &statistics) {
+  AnalysisFunction analysis = find_analysis(domain, engine);
+  if (!analysis) {
+    return false;
+  }
+  analysis(module, out, statistics);
+  return true;
+}
+
+} // namespace pcpo
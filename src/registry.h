@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <llvm/IR/Module.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "fixpoint.h"
+
+namespace pcpo {
+
+/// Runs the analysis of a domain with a fixpoint engine on a module, and
+/// prints the outgoing state of every reached block to out (see analyze_with).
+using AnalysisFunction = void (*)(llvm::Module const &M, llvm::raw_ostream &out,
+                                  AnalysisStatistics &statistics);
+
+/// Adds the analysis of domain with engine to the registry. Each pair of domain
+/// and engine is registered by a static instance in the translation unit that
+/// instantiates the fixpoint engine for it, see analysis_*.cpp.
+class AnalysisRegistration {
+public:
+  AnalysisRegistration(char const *domain, char const *engine,
+                       AnalysisFunction analysis);
+};
+
+/// The analysis registered for domain and engine, or nullptr if there is none.
+AnalysisFunction find_analysis(std::string const &domain,
+                               std::string const &engine);
+
+/// The registered domains and engines, sorted by name.
+std::vector<std::string> registered_domains();
+std::vector<std::string> registered_engines();
+
+/// Runs the analysis with the given domain and engine on `module`, as done by
+/// pain-analyze, and prints the outgoing state of every reached block, joined
+/// over all contexts, to `out`. Returns false if the domain or engine is
+/// unknown.
+bool analyze_module(llvm::Module const &module, std::string const &domain,
+                    std::string const &engine, llvm::raw_ostream &out,
+                    AnalysisStatistics &statistics);
+
+} // namespace pcpo
@@ -103,6 +103,34 @@ static SimpleInterval _icmp_shift(SimpleInterval a) {
 SimpleInterval SimpleInterval::interpret(
     llvm::Instruction const& inst, std::vector<SimpleInterval> const& operands
 ) {    
+    // Casts between integer types, which take a single operand
+    if (operands.size() == 1 and llvm::isa<llvm::CastInst>(inst)) {
+        llvm::IntegerType const* from = llvm::dyn_cast<llvm::IntegerType>(inst.getOperand(0)->getType());
+        llvm::IntegerType const* to   = llvm::dyn_cast<llvm::IntegerType>(inst.getType());
+        if (not from or not to) return SimpleInterval {true};
+        if (operands[0].isBottom()) return SimpleInterval {};
+        return operands[0]._makeTopInterval(from->getBitWidth())
+            ._Cast(inst.getOpcode(), to->getBitWidth())._makeTopSpecial();
+    }
+
+    // The *.with.overflow intrinsics, as emitted by -fsanitize=signed-integer-overflow, stand for
+    // their wrapping result, element 0 of the aggregate they return. Their overflow bit, element 1,
+    // is not modelled.
+    if (llvm::WithOverflowInst const* intrinsic = llvm::dyn_cast<llvm::WithOverflowInst>(&inst)) {
+        llvm::Type const* type = intrinsic->getLHS()->getType();
+        if (not type->isIntegerTy()) return SimpleInterval {true};
+        unsigned bitWidth = type->getIntegerBitWidth();
+        return _binary(
+            intrinsic->getBinaryOp(), operands[0]._makeTopInterval(bitWidth),
+            operands[1]._makeTopInterval(bitWidth), false, false
+        );
+    }
+    if (llvm::ExtractValueInst const* extract = llvm::dyn_cast<llvm::ExtractValueInst>(&inst)) {
+        bool result = extract->getNumIndices() == 1 and *extract->idx_begin() == 0
+            and llvm::isa<llvm::WithOverflowInst>(extract->getAggregateOperand());
+        return result ? operands[0] : SimpleInterval {true};
+    }
+
     if (operands.size() != 2) return SimpleInterval {true};
 
     // We only deal with integer types
@@ -146,6 +174,12 @@ SimpleInterval SimpleInterval::interpret(
         }
     }
 
+    return _binary(inst.getOpcode(), a, b, inst.hasNoUnsignedWrap(), inst.hasNoSignedWrap());
+}
+
+SimpleInterval SimpleInterval::_binary(
+    unsigned opcode, SimpleInterval a, SimpleInterval b, bool nuw, bool nsw
+) {
     // We need to check for bottom after determining the type of the operation, because some weird
     // ones may actually return values even of bottom. (E.g. phi nodes, though those are handled in
     // the layer above.)
@@ -153,13 +187,13 @@ SimpleInterval SimpleInterval::interpret(
 #define DO_BINARY_OV(x)                                                 \
     case llvm::Instruction::x:                                          \
         if (a.isBottom() or b.isBottom()) return SimpleInterval {};     \
-        return a._##x(b, inst.hasNoUnsignedWrap(), inst.hasNoSignedWrap())._makeTopSpecial();
+        return a._##x(b, nuw, nsw)._makeTopSpecial();
 #define DO_BINARY(x)                                                    \
     case llvm::Instruction::x:                                          \
         if (a.isBottom() or b.isBottom()) return SimpleInterval {};     \
         return a._##x(b)._makeTopSpecial();
     
-    switch (inst.getOpcode()) {
+    switch (opcode) {
         DO_BINARY_OV(Add);
         DO_BINARY_OV(Sub);
         DO_BINARY_OV(Mul);
@@ -224,6 +258,8 @@ SimpleInterval SimpleInterval::_refineBranch(
 SimpleInterval SimpleInterval::merge(Merge_op::Type op, SimpleInterval a, SimpleInterval b) {
     if (a.isBottom()) return b;
     if (b.isBottom()) return a;
+    // Narrowing may recover a bound that widening gave up on
+    if (op == Merge_op::NARROW && a.isTop()) return b;
     if (a.isTop() || b.isTop()) return SimpleInterval {true};
 
     // Note that T is handled above, so no need to convert the inputs
@@ -416,10 +452,29 @@ SimpleInterval SimpleInterval::_UDiv (SimpleInterval o) const {
 
 
 SimpleInterval SimpleInterval::_URem (SimpleInterval o) const {
-    if (_umax().ule(o._umax())) {
+    // The remainder is smaller than the divisor, division by zero is undefined
+    APInt divisor_max = o._umax() - !o._umax().isNullValue();
+    if (_umax().ule(divisor_max)) {
         return SimpleInterval(APInt::getMinValue(begin.getBitWidth()), _umax());
     } else {
-        return SimpleInterval(APInt::getMinValue(begin.getBitWidth()), o._umax());
+        return SimpleInterval(APInt::getMinValue(begin.getBitWidth()), divisor_max);
+    }
+}
+
+SimpleInterval SimpleInterval::_Cast(unsigned opcode, unsigned bitWidth) const {
+    switch (opcode) {
+    case llvm::Instruction::ZExt:
+        return SimpleInterval {_umin().zext(bitWidth), _umax().zext(bitWidth)};
+    case llvm::Instruction::SExt:
+        return SimpleInterval {_smin().sext(bitWidth), _smax().sext(bitWidth)};
+    case llvm::Instruction::Trunc:
+        // The values stay contiguous if there are fewer of them than the narrow type has
+        if ((end - begin).getActiveBits() <= bitWidth) {
+            return SimpleInterval {begin.trunc(bitWidth), end.trunc(bitWidth)};
+        }
+        return SimpleInterval {true}._makeTopInterval(bitWidth);
+    default:
+        return SimpleInterval {true}._makeTopInterval(bitWidth);
     }
 }
 
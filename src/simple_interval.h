@@ -2,6 +2,7 @@
 
 #include <llvm/ADT/APInt.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
 
 #include "global.h"
 
@@ -74,6 +75,10 @@ public:
     SimpleInterval _UDiv(SimpleInterval o) const;
     SimpleInterval _URem(SimpleInterval o) const;
     SimpleInterval _SRem(SimpleInterval o) const;
+    SimpleInterval _Cast(unsigned opcode, unsigned bitWidth) const;
+    static SimpleInterval _binary(
+        unsigned opcode, SimpleInterval a, SimpleInterval b, bool nuw, bool nsw
+    );
     SimpleInterval _upperBound(SimpleInterval o) const;
     SimpleInterval _widen(SimpleInterval o) const;
     SimpleInterval _narrow(SimpleInterval o) const;
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+
+#include <llvm/IR/Instructions.h>
+#include <llvm/Transforms/Utils/Local.h>
+
+#include "global.h"
+#include "simple_interval.h"
+#include "value_set.h"
+
+namespace pcpo {
+
+/// Interval analysis whose results are used to simplify switches: cases whose
+/// value lies outside the interval of the condition are removed, and if the
+/// remaining cases cover the whole interval, the default becomes unreachable.
+class SwitchPruning : public AbstractStateValueSet<SimpleInterval> {
+public:
+  using AbstractStateValueSet<SimpleInterval>::AbstractStateValueSet;
+
+  void applyPHINode(llvm::BasicBlock const &bb,
+                    std::vector<SwitchPruning> const &pred_values,
+                    llvm::Instruction const &inst) {
+    std::vector<AbstractStateValueSet<SimpleInterval>> preds(
+        pred_values.begin(), pred_values.end());
+    AbstractStateValueSet<SimpleInterval>::applyPHINode(bb, preds, inst);
+  }
+
+  /// Prunes the switches of function, where state_of(bb) is the outgoing
+  /// state of bb, joined over all contexts. Blocks that lose their last
+  /// predecessor are deleted. Returns whether the function changed.
+  template <typename StateOf>
+  static bool transformFunction(llvm::Function &function,
+                                StateOf const &state_of) {
+    // The states refer to the blocks that are deleted, so decide first
+    std::vector<std::pair<llvm::SwitchInst *, SimpleInterval>> switches;
+    for (llvm::BasicBlock &bb : function) {
+      SwitchPruning const &state = state_of(&bb);
+      auto sw = dyn_cast<llvm::SwitchInst>(bb.getTerminator());
+      if (state.isBottom || !sw)
+        continue;
+
+      SimpleInterval condition = state.getAbstractValue(*sw->getCondition());
+      if (condition.state == SimpleInterval::NORMAL) {
+        switches.push_back({sw, condition});
+      }
+    }
+
+    bool hasChanged = false;
+    for (auto [sw, condition] : switches) {
+      hasChanged |= prune(*sw, condition);
+    }
+    if (hasChanged) {
+      llvm::removeUnreachableBlocks(function);
+    }
+    return hasChanged;
+  }
+
+private:
+  static bool prune(llvm::SwitchInst &sw, SimpleInterval const &condition) {
+    llvm::BasicBlock *bb = sw.getParent();
+    bool hasChanged = false;
+
+    for (auto it = sw.case_begin(); it != sw.case_end();) {
+      if (condition.contains(it->getCaseValue()->getValue())) {
+        ++it;
+        continue;
+      }
+      dbgs(3) << "  Removing case " << it->getCaseValue()->getValue()
+              << " of switch in %" << bb->getName() << ", condition is "
+              << condition << '\n';
+      it->getCaseSuccessor()->removePredecessor(bb);
+      it = sw.removeCase(it);
+      hasChanged = true;
+    }
+
+    // Every value of the condition has its case, so the default is dead. The
+    // interval has at most as many values as there are cases here.
+    llvm::APInt size = condition.end - condition.begin;
+    bool default_dead = size.ult(sw.getNumCases());
+    llvm::BasicBlock *old_default = sw.getDefaultDest();
+    if (default_dead &&
+        !isa<llvm::UnreachableInst>(old_default->getFirstNonPHIOrDbg())) {
+      dbgs(3) << "  Default of switch in %" << bb->getName()
+              << " is unreachable, condition is " << condition << '\n';
+      llvm::BasicBlock *unreachable = llvm::BasicBlock::Create(
+          bb->getContext(), "default.unreachable", bb->getParent(),
+          old_default);
+      new llvm::UnreachableInst(bb->getContext(), unreachable);
+      old_default->removePredecessor(bb);
+      sw.setDefaultDest(unreachable);
+      hasChanged = true;
+    }
+
+    return hasChanged;
+  }
+};
+
+} // namespace pcpo
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Metadata.h>
+
+#include "global.h"
+#include "simple_interval.h"
+#include "value_set.h"
+
+namespace pcpo {
+
+/// Interval analysis whose results bound how often the header of a loop is
+/// executed. The loop needs an induction variable i with a constant step s
+/// and a start value in [begin_lo, begin_hi]. If i stays within [lo, hi] in
+/// the header and s > 0, the header runs at most (hi - begin_lo) / s + 1
+/// times, as i + s does not wrap past hi. An exit is only taken once the
+/// refinement of the exit branch admits i, which bounds the count from below.
+/// Negative steps are symmetric. The bounds are attached to the loop as
+/// !llvm.loop metadata, pain.loop.min_trip_count and pain.loop.max_trip_count,
+/// and are reported.
+class TripCountInference : public AbstractStateValueSet<SimpleInterval> {
+public:
+  using AbstractStateValueSet<SimpleInterval>::AbstractStateValueSet;
+
+  void applyPHINode(llvm::BasicBlock const &bb,
+                    std::vector<TripCountInference> const &pred_values,
+                    llvm::Instruction const &inst) {
+    std::vector<AbstractStateValueSet<SimpleInterval>> preds(
+        pred_values.begin(), pred_values.end());
+    AbstractStateValueSet<SimpleInterval>::applyPHINode(bb, preds, inst);
+  }
+
+  /// Annotates the loops of function with their trip counts, where
+  /// state_of(bb) is the outgoing state of bb, joined over all contexts.
+  /// Returns whether the function changed.
+  template <typename StateOf>
+  static bool transformFunction(llvm::Function &function,
+                                StateOf const &state_of) {
+    llvm::DominatorTree dominators{function};
+    llvm::LoopInfo loops{dominators};
+    bool hasChanged = false;
+
+    for (llvm::Loop *loop : loops.getLoopsInPreorder()) {
+      llvm::BasicBlock *header = loop->getHeader();
+      TripCountInference const &state = state_of(header);
+      if (state.isBottom)
+        continue;
+
+      // The tightest bounds of all induction variables
+      Bounds bounds{1, UINT64_MAX};
+      for (llvm::PHINode &phi : header->phis()) {
+        Bounds phi_bounds{1, UINT64_MAX};
+        if (!tripCount(phi, *loop, dominators, state_of, phi_bounds))
+          continue;
+        bounds.min = std::max(bounds.min, phi_bounds.min);
+        bounds.max = std::min(bounds.max, phi_bounds.max);
+      }
+      if (bounds.max == UINT64_MAX || bounds.min > bounds.max)
+        continue;
+
+      report() << function.getName() << ": loop %" << header->getName()
+               << " runs ";
+      if (bounds.min != bounds.max) {
+        report() << bounds.min << " to ";
+      }
+      report() << bounds.max << (bounds.max != 1 ? " times\n" : " time\n");
+      hasChanged |= annotate(*loop, bounds);
+    }
+
+    return hasChanged;
+  }
+
+private:
+  /// Bounds of the number of times the header is executed, per entry
+  struct Bounds {
+    uint64_t min;
+    uint64_t max;
+  };
+
+  /// Bounds the trip count of loop with the induction variable phi. Returns
+  /// false if phi is none or nothing is known.
+  template <typename StateOf>
+  static bool tripCount(llvm::PHINode &phi, llvm::Loop const &loop,
+                        llvm::DominatorTree const &dominators,
+                        StateOf const &state_of, Bounds &bounds) {
+    if (!phi.getType()->isIntegerTy())
+      return false;
+
+    // The increment on the back edges, and the start values on the others
+    llvm::BinaryOperator *increment = nullptr;
+    SimpleInterval begin{};
+    for (unsigned i = 0; i < phi.getNumIncomingValues(); ++i) {
+      llvm::BasicBlock *block = phi.getIncomingBlock(i);
+      llvm::Value *value = phi.getIncomingValue(i);
+      if (!loop.contains(block)) {
+        TripCountInference const &pred = state_of(block);
+        if (!pred.isBottom) {
+          begin = SimpleInterval::merge(Merge_op::UPPER_BOUND, begin,
+                                        pred.getAbstractValue(*value));
+        }
+        continue;
+      }
+      auto op = dyn_cast<llvm::BinaryOperator>(value);
+      if (!op || (increment && op != increment))
+        return false;
+      increment = op;
+    }
+
+    llvm::APInt step;
+    if (!increment || !stepOf(*increment, phi, step) ||
+        begin.state != SimpleInterval::NORMAL)
+      return false;
+    SimpleInterval values = state_of(phi.getParent()).getAbstractValue(phi);
+    if (values.state != SimpleInterval::NORMAL)
+      return false;
+
+    // Work with sign-extended values, which cannot overflow. Negative steps
+    // are mirrored.
+    unsigned width = phi.getType()->getIntegerBitWidth() + 2;
+    bool down = step.isNegative();
+    auto extend = [width, down](llvm::APInt const &value) {
+      llvm::APInt result = value.sext(width);
+      return down ? -result : result;
+    };
+    llvm::APInt s = extend(step);
+    llvm::APInt begin_lo = extend(down ? begin._smax() : begin._smin());
+    llvm::APInt begin_hi = extend(down ? begin._smin() : begin._smax());
+    llvm::APInt hi = extend(down ? values._smin() : values._smax());
+    llvm::APInt limit = extend(down ? llvm::APInt::getSignedMinValue(width - 2)
+                                    : llvm::APInt::getSignedMaxValue(width - 2));
+
+    // Past hi, i + s must not wrap around into [lo, hi] again
+    if (hi.sgt(limit - s) || begin_lo.sgt(hi))
+      return false;
+    bounds.max = toCount(hi - begin_lo, s, false) + 1;
+
+    // The earliest iteration k in which an exit admits i = begin + k * s.
+    // Without a feasible exit, the loop is never left.
+    llvm::SmallVector<llvm::BasicBlock *, 4> exiting;
+    loop.getExitingBlocks(exiting);
+    llvm::APInt earliest = llvm::APInt::getSignedMaxValue(width);
+    for (llvm::BasicBlock *block : exiting) {
+      TripCountInference const &from = state_of(block);
+      if (from.isBottom)
+        continue;
+      for (llvm::BasicBlock *successor : llvm::successors(block)) {
+        if (loop.contains(successor))
+          continue;
+        AbstractStateValueSet<SimpleInterval> towards{from};
+        towards.branch(*block, *successor);
+        if (towards.isBottom)
+          continue;
+
+        // i, or i + s if only the increment is refined. The increment
+        // belongs to the current iteration if it dominates the exit.
+        SimpleInterval at_exit = towards.getAbstractValue(phi);
+        llvm::APInt k = llvm::APInt(width, 0);
+        if (at_exit.state == SimpleInterval::NORMAL) {
+          llvm::APInt value = extend(down ? at_exit._smax() : at_exit._smin());
+          if (value.sgt(begin_hi)) {
+            k = llvm::APInt(width, toCount(value - begin_hi, s, true));
+          }
+        }
+        SimpleInterval next = towards.getAbstractValue(*increment);
+        if (dominators.dominates(increment->getParent(), block) &&
+            next.state == SimpleInterval::NORMAL) {
+          llvm::APInt value = extend(down ? next._smax() : next._smin()) - s;
+          if (value.sgt(begin_hi)) {
+            k = llvm::APIntOps::smax(
+                k, llvm::APInt(width, toCount(value - begin_hi, s, true)));
+          }
+        }
+        earliest = llvm::APIntOps::smin(earliest, k);
+      }
+    }
+    if (!earliest.isMaxSignedValue()) {
+      bounds.min = earliest.getLimitedValue(UINT64_MAX - 1) + 1;
+    }
+    return true;
+  }
+
+  /// The constant step of the recurrence phi = phi op step
+  static bool stepOf(llvm::BinaryOperator const &increment,
+                     llvm::PHINode const &phi, llvm::APInt &step) {
+    unsigned opcode = increment.getOpcode();
+    auto constant = dyn_cast<llvm::ConstantInt>(increment.getOperand(1));
+    if (opcode == llvm::Instruction::Add && !constant &&
+        increment.getOperand(1) == &phi) {
+      constant = dyn_cast<llvm::ConstantInt>(increment.getOperand(0));
+    } else if (increment.getOperand(0) != &phi) {
+      return false;
+    }
+    if (!constant || (opcode != llvm::Instruction::Add &&
+                      opcode != llvm::Instruction::Sub))
+      return false;
+    step = opcode == llvm::Instruction::Add ? constant->getValue()
+                                            : -constant->getValue();
+    return !step.isNullValue();
+  }
+
+  /// distance / step, rounded up or down, for non-negative distances
+  static uint64_t toCount(llvm::APInt const &distance, llvm::APInt const &step,
+                          bool round_up) {
+    llvm::APInt quotient = distance.udiv(step);
+    if (round_up && !distance.urem(step).isNullValue()) {
+      quotient += 1;
+    }
+    return quotient.getLimitedValue(UINT64_MAX - 1);
+  }
+
+  /// Replaces the trip counts in the loop id of loop. Returns whether they
+  /// changed.
+  static bool annotate(llvm::Loop &loop, Bounds const &bounds) {
+    llvm::LLVMContext &context = loop.getHeader()->getContext();
+    llvm::Type *type = llvm::Type::getInt64Ty(context);
+    auto property = [&](char const *name, uint64_t value) {
+      llvm::Metadata *ops[] = {
+          llvm::MDString::get(context, name),
+          llvm::ConstantAsMetadata::get(llvm::ConstantInt::get(type, value))};
+      return llvm::MDNode::get(context, ops);
+    };
+
+    // The first operand refers to the loop id itself
+    llvm::SmallVector<llvm::Metadata *, 4> ops = {nullptr};
+    llvm::MDNode *old_id = loop.getLoopID();
+    if (old_id) {
+      for (unsigned i = 1; i < old_id->getNumOperands(); ++i) {
+        auto node = dyn_cast<llvm::MDNode>(old_id->getOperand(i));
+        auto name = node && node->getNumOperands() > 0
+                        ? dyn_cast<llvm::MDString>(node->getOperand(0))
+                        : nullptr;
+        if (!name || !name->getString().startswith("pain.loop.")) {
+          ops.push_back(old_id->getOperand(i));
+        }
+      }
+    }
+    ops.push_back(property("pain.loop.min_trip_count", bounds.min));
+    ops.push_back(property("pain.loop.max_trip_count", bounds.max));
+
+    if (old_id && old_id->getNumOperands() == ops.size()) {
+      bool same = true;
+      for (unsigned i = 1; i < ops.size(); ++i) {
+        same &= old_id->getOperand(i) == ops[i];
+      }
+      if (same)
+        return false;
+    }
+    llvm::MDNode *id = llvm::MDNode::getDistinct(context, ops);
+    id->replaceOperandWith(0, id);
+    loop.setLoopID(id);
+    return true;
+  }
+};
+
+} // namespace pcpo
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <unordered_map>
 #include <vector>
 
@@ -152,7 +153,9 @@ public:
                 llvm::Value const* ret_val = ret_inst->getReturnValue();
                 dbgs(4) << "      Found return instruction\n";
 
-                if (callee_state.values.find(ret_val) != callee_state.values.end()) {
+                if (ret_val && llvm::isa<llvm::Constant>(ret_val) && !callee_state.isBottom) {
+                    values[&inst] = callee_state.getAbstractValue(*ret_val);
+                } else if (callee_state.values.find(ret_val) != callee_state.values.end()) {
                     dbgs(4) << "      Return evaluated, merging parameters\n";
                     values[&inst] = callee_state.values.at(ret_val);
                 } else {
@@ -271,12 +274,64 @@ public:
         
         return changed;
     }
+
+    // Difference of a state to a base state, see deltaFrom.
+    struct Delta {
+        // Values that are new or differ from the base
+        std::unordered_map<llvm::Value const*, AbstractDomain> changed;
+        // Values of the base that the state does not have
+        std::vector<llvm::Value const*> removed;
+        bool isBottom = true;
+    };
+
+    // Returns the delta that turns base into this state with applyDelta.
+    Delta deltaFrom(AbstractStateValueSet const& base) const {
+        Delta delta;
+        delta.isBottom = isBottom;
+        for (auto const& [value, abstract]: values) {
+            auto it = base.values.find(value);
+            if (it == base.values.end() || !(it->second == abstract)) {
+                delta.changed.emplace(value, abstract);
+            }
+        }
+        for (auto const& [value, abstract]: base.values) {
+            if (!values.count(value)) delta.removed.push_back(value);
+        }
+        return delta;
+    }
+
+    void applyDelta(Delta const& delta) {
+        for (llvm::Value const* value: delta.removed) {
+            values.erase(value);
+        }
+        for (auto const& [value, abstract]: delta.changed) {
+            values[value] = abstract;
+        }
+        isBottom = delta.isBottom;
+    }
+
+    // Forgets the values for which keep returns false. Values that are not in the state are
+    // treated as unknown by getAbstractValue.
+    void project(std::function<bool(llvm::Value const*)> const& keep) {
+        for (auto it = values.begin(); it != values.end();) {
+            if (keep(it->first)) {
+                ++it;
+            } else {
+                it = values.erase(it);
+            }
+        }
+    }
     
     void branch(llvm::BasicBlock const& from, llvm::BasicBlock const& towards) {
         llvm::Instruction const* terminator = from.getTerminator();
         assert(terminator /* from is not a well-formed basic block! */);
         assert(terminator->isTerminator());
 
+        if (auto sw = llvm::dyn_cast<llvm::SwitchInst>(terminator)) {
+            branchSwitch(*sw, towards);
+            return;
+        }
+
         llvm::BranchInst const* branch = llvm::dyn_cast<llvm::BranchInst>(terminator);
 
         // If the terminator is not a simple branch, we are not interested
@@ -363,6 +418,41 @@ public:
 		//checkForBottom(4);
     }
 
+    // Refine the condition of a switch on the edge towards the block towards. A case edge restricts
+    // it to the value of the case, the default edge excludes the values of all other cases. If both
+    // lead to towards, the join is taken.
+    void branchSwitch(llvm::SwitchInst const& sw, llvm::BasicBlock const& towards) {
+        llvm::Value const& condition = *sw.getCondition();
+        if (not values.count(&condition)) return;
+
+        dbgs(3) << "      Detected switch from " << sw.getParent()->getName() << " towards "
+                << towards.getName() << " on %" << condition.getName() << " = " << values[&condition] << '\n';
+
+        AbstractDomain const value = values[&condition];
+        AbstractDomain value_new; // Set to bottom
+        for (auto const& c: sw.cases()) {
+            if (c.getCaseSuccessor() != &towards) continue;
+            llvm::ConstantInt const& case_value = *c.getCaseValue();
+            AbstractDomain value_case = AbstractDomain::refineBranch(llvm::CmpInst::ICMP_EQ, condition,
+                case_value, value, getAbstractValue(case_value));
+            value_new = AbstractDomain::merge(Merge_op::UPPER_BOUND, value_new, value_case);
+        }
+        if (sw.getDefaultDest() == &towards) {
+            AbstractDomain value_default = value;
+            for (auto const& c: sw.cases()) {
+                if (c.getCaseSuccessor() == &towards) continue;
+                llvm::ConstantInt const& case_value = *c.getCaseValue();
+                value_default = AbstractDomain::refineBranch(llvm::CmpInst::ICMP_NE, condition,
+                    case_value, value_default, getAbstractValue(case_value));
+            }
+            value_new = AbstractDomain::merge(Merge_op::UPPER_BOUND, value_new, value_default);
+        }
+
+        values[&condition] = value_new;
+        dbgs(3) << "      Value restricted to %" << condition.getName() << " = " << values[&condition] << '\n';
+        checkValueForBottom(6, &condition);
+    }
+
     void printIncoming(llvm::BasicBlock const& bb, llvm::raw_ostream& out, int indentation = 0) const {
         // @Speed: This is quadratic, could be linear
         bool nothing = true;
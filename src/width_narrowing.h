@@ -0,0 +1,282 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/InstrTypes.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+
+#include "global.h"
+#include "simple_interval.h"
+#include "value_set.h"
+
+namespace pcpo {
+
+/// Interval analysis whose results are used to compute integer arithmetic in
+/// the narrowest legal type that holds every value. Truncation commutes with
+/// add, sub, mul, and, or, xor, select and phi, so a chain of them is computed
+/// narrow and only extended again where the result leaves the chain.
+class WidthNarrowing : public AbstractStateValueSet<SimpleInterval> {
+public:
+  using AbstractStateValueSet<SimpleInterval>::AbstractStateValueSet;
+
+  void applyPHINode(llvm::BasicBlock const &bb,
+                    std::vector<WidthNarrowing> const &pred_values,
+                    llvm::Instruction const &inst) {
+    std::vector<AbstractStateValueSet<SimpleInterval>> preds(
+        pred_values.begin(), pred_values.end());
+    AbstractStateValueSet<SimpleInterval>::applyPHINode(bb, preds, inst);
+  }
+
+  /// Narrows the arithmetic of function, where state_of(bb) is the outgoing
+  /// state of bb, joined over all contexts. Returns whether the function
+  /// changed.
+  template <typename StateOf>
+  static bool transformFunction(llvm::Function &function,
+                                StateOf const &state_of) {
+    std::vector<unsigned> widths = legalWidths(*function.getParent());
+
+    // Decide on the width of every candidate first, so that the operands of
+    // a narrowed instruction can be taken from the narrowed chain
+    std::unordered_map<llvm::Instruction *, Narrowed> narrowed;
+    std::vector<llvm::Instruction *> order;
+    for (llvm::BasicBlock &bb : function) {
+      WidthNarrowing const &state = state_of(&bb);
+      if (state.isBottom)
+        continue;
+
+      for (llvm::Instruction &inst : bb) {
+        if (!isCandidate(inst))
+          continue;
+        Narrowed result{};
+        if (state.chooseWidth(inst, widths, result)) {
+          narrowed[&inst] = result;
+          order.push_back(&inst);
+        }
+      }
+    }
+
+    // A lone instruction would only gain conversions
+    std::vector<llvm::Instruction *> chained;
+    std::vector<llvm::Instruction *> lone;
+    for (llvm::Instruction *inst : order) {
+      (isChained(*inst, narrowed) ? chained : lone).push_back(inst);
+    }
+    for (llvm::Instruction *inst : lone) {
+      narrowed.erase(inst);
+    }
+    if (chained.empty())
+      return false;
+
+    for (llvm::Instruction *inst : chained) {
+      createNarrow(*inst, narrowed[inst]);
+    }
+    for (llvm::Instruction *inst : chained) {
+      setNarrowOperands(*inst, narrowed);
+    }
+
+    // Extend the results again for the remaining users
+    std::vector<llvm::Instruction *> extensions;
+    for (llvm::Instruction *inst : chained) {
+      Narrowed const &result = narrowed[inst];
+      llvm::Instruction *insert_before =
+          isa<llvm::PHINode>(inst) ? &*inst->getParent()->getFirstInsertionPt()
+                                   : inst;
+      llvm::Instruction *extension = llvm::CastInst::Create(
+          result.is_signed ? llvm::Instruction::SExt : llvm::Instruction::ZExt,
+          result.value, inst->getType(), "", insert_before);
+      dbgs(3) << "  Narrowed" << *inst << " to i" << result.width << '\n';
+      extension->takeName(inst);
+      inst->replaceAllUsesWith(extension);
+      extensions.push_back(extension);
+    }
+    for (llvm::Instruction *inst : chained) {
+      inst->eraseFromParent();
+    }
+    for (llvm::Instruction *extension : extensions) {
+      if (extension->use_empty()) {
+        extension->eraseFromParent();
+      }
+    }
+
+    return true;
+  }
+
+private:
+  struct Narrowed {
+    unsigned width;
+    bool is_signed;
+    llvm::Instruction *value;
+  };
+
+  /// The legal integer widths of the target, ascending. Without a data layout
+  /// i8, i16 and i32 are assumed.
+  static std::vector<unsigned> legalWidths(llvm::Module const &module) {
+    llvm::DataLayout const &layout = module.getDataLayout();
+    if (layout.getLargestLegalIntTypeSizeInBits() == 0) {
+      return {8, 16, 32};
+    }
+    std::vector<unsigned> widths;
+    for (unsigned width = 8; width <= 32; width *= 2) {
+      if (layout.isLegalInteger(width)) {
+        widths.push_back(width);
+      }
+    }
+    return widths;
+  }
+
+  static bool isCandidate(llvm::Instruction const &inst) {
+    if (!inst.getType()->isIntegerTy())
+      return false;
+    if (isa<llvm::PHINode>(inst) || isa<llvm::SelectInst>(inst))
+      return true;
+    switch (inst.getOpcode()) {
+    case llvm::Instruction::Add:
+    case llvm::Instruction::Sub:
+    case llvm::Instruction::Mul:
+    case llvm::Instruction::And:
+    case llvm::Instruction::Or:
+    case llvm::Instruction::Xor:
+      return true;
+    }
+    return false;
+  }
+
+  /// Picks the narrowest width that holds the interval of inst, as zero or
+  /// sign extension. Returns false if there is none narrower than inst.
+  bool chooseWidth(llvm::Instruction const &inst,
+                   std::vector<unsigned> const &widths,
+                   Narrowed &result) const {
+    SimpleInterval interval = getAbstractValue(inst);
+    if (interval.state != SimpleInterval::NORMAL)
+      return false;
+
+    unsigned bits = inst.getType()->getIntegerBitWidth();
+    for (unsigned width : widths) {
+      if (width >= bits)
+        break;
+      if (interval._umax().getActiveBits() <= width) {
+        result = {width, false, nullptr};
+        return true;
+      }
+      if (interval._smin().getMinSignedBits() <= width &&
+          interval._smax().getMinSignedBits() <= width) {
+        result = {width, true, nullptr};
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static bool
+  isChained(llvm::Instruction &inst,
+            std::unordered_map<llvm::Instruction *, Narrowed> const &narrowed) {
+    for (llvm::Value *operand : inst.operands()) {
+      if (narrowed.count(dyn_cast<llvm::Instruction>(operand)))
+        return true;
+    }
+    for (llvm::User *user : inst.users()) {
+      if (narrowed.count(dyn_cast<llvm::Instruction>(user)))
+        return true;
+    }
+    return false;
+  }
+
+  /// Creates the narrow copy of inst in front of it, with undefined operands
+  static void createNarrow(llvm::Instruction &inst, Narrowed &result) {
+    llvm::Type *type = llvm::IntegerType::get(inst.getContext(), result.width);
+    llvm::Value *undef = llvm::UndefValue::get(type);
+    std::string name = (inst.getName() + ".narrow").str();
+
+    if (auto phi = dyn_cast<llvm::PHINode>(&inst)) {
+      result.value = llvm::PHINode::Create(type, phi->getNumIncomingValues(),
+                                           name, &inst);
+    } else if (auto select = dyn_cast<llvm::SelectInst>(&inst)) {
+      result.value = llvm::SelectInst::Create(select->getCondition(), undef,
+                                              undef, name, &inst);
+    } else {
+      result.value = llvm::BinaryOperator::Create(
+          static_cast<llvm::Instruction::BinaryOps>(inst.getOpcode()), undef,
+          undef, name, &inst);
+    }
+  }
+
+  static void setNarrowOperands(
+      llvm::Instruction &inst,
+      std::unordered_map<llvm::Instruction *, Narrowed> const &narrowed) {
+    Narrowed const &result = narrowed.at(&inst);
+
+    if (auto phi = dyn_cast<llvm::PHINode>(&inst)) {
+      auto narrow_phi = llvm::cast<llvm::PHINode>(result.value);
+      for (unsigned i = 0; i < phi->getNumIncomingValues(); ++i) {
+        llvm::BasicBlock *block = phi->getIncomingBlock(i);
+        // A block may occur several times, but always with the same value
+        int index = narrow_phi->getBasicBlockIndex(block);
+        llvm::Value *value =
+            index >= 0 ? narrow_phi->getIncomingValue(index)
+                       : narrowValue(*phi->getIncomingValue(i), result.width,
+                                     narrowed, block->getTerminator());
+        narrow_phi->addIncoming(value, block);
+      }
+      return;
+    }
+
+    // The condition of a select stays as it is
+    unsigned first = isa<llvm::SelectInst>(inst) ? 1 : 0;
+    for (unsigned i = first; i < inst.getNumOperands(); ++i) {
+      result.value->setOperand(i, narrowValue(*inst.getOperand(i),
+                                              result.width, narrowed,
+                                              result.value));
+    }
+  }
+
+  /// The lowest width bits of value, inserted before insert_before if any
+  /// instruction is needed
+  static llvm::Value *
+  narrowValue(llvm::Value &value, unsigned width,
+              std::unordered_map<llvm::Instruction *, Narrowed> const &narrowed,
+              llvm::Instruction *insert_before) {
+    llvm::Type *type = llvm::IntegerType::get(value.getContext(), width);
+
+    if (auto constant = dyn_cast<llvm::Constant>(&value)) {
+      return llvm::ConstantExpr::getTrunc(constant, type);
+    }
+
+    if (auto inst = dyn_cast<llvm::Instruction>(&value)) {
+      auto it = narrowed.find(inst);
+      if (it != narrowed.end()) {
+        Narrowed const &other = it->second;
+        if (other.width == width)
+          return other.value;
+        if (other.width > width)
+          return llvm::CastInst::Create(llvm::Instruction::Trunc, other.value,
+                                        type, "", insert_before);
+        return llvm::CastInst::Create(other.is_signed
+                                          ? llvm::Instruction::SExt
+                                          : llvm::Instruction::ZExt,
+                                      other.value, type, "", insert_before);
+      }
+
+      // Values that were extended from a narrow type are extended to width
+      // directly
+      if (isa<llvm::ZExtInst>(inst) || isa<llvm::SExtInst>(inst)) {
+        llvm::Value *source = inst->getOperand(0);
+        unsigned source_width = source->getType()->getIntegerBitWidth();
+        if (source_width == width)
+          return source;
+        if (source_width < width)
+          return llvm::CastInst::Create(
+              static_cast<llvm::Instruction::CastOps>(inst->getOpcode()),
+              source, type, "", insert_before);
+      }
+    }
+
+    return llvm::CastInst::Create(llvm::Instruction::Trunc, &value, type, "",
+                                  insert_before);
+  }
+};
+
+} // namespace pcpo
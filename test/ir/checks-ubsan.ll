@@ -0,0 +1,129 @@
+; UBSan checks as emitted by clang -O0 -Xclang -disable-O0-optnone
+; -fsanitize=signed-integer-overflow,bounds and cleaned up by mem2reg, for
+;
+;   int arr[100];
+;   int main() {
+;       int sum = 0;
+;       for (int i = 0; i < 100; i++) {
+;           arr[i] = i * 3;
+;           sum += rand();
+;       }
+;       return sum;
+;   }
+;
+; The loop counter goes through @llvm.sadd.with.overflow and is sign extended
+; for the index. %i.0 is in [0, 100), so the multiplication check, the bounds
+; check and the check of the increment can never fire and are removed. The
+; addition of a random value keeps its check.
+
+; CHECK-LABEL: define dso_local i32 @main(
+; CHECK-NOT:     @llvm.smul.with.overflow
+; CHECK:         mul nsw i32 %i.0, 3
+; CHECK-NOT:     @__ubsan_handle_mul_overflow(
+; CHECK:         %idxprom = sext i32 %i.0 to i64
+; CHECK-NOT:     @__ubsan_handle_out_of_bounds(
+; CHECK:         @llvm.sadd.with.overflow.i32(i32 %sum.0, i32 %call)
+; CHECK:         call void @__ubsan_handle_add_overflow(
+; CHECK:       for.inc:
+; CHECK-NEXT:    add nsw i32 %i.0, 1
+; CHECK-NOT:     @__ubsan_handle_add_overflow(
+; CHECK:         ret i32 %sum.0
+
+@.src = private unnamed_addr constant [8 x i8] c"ubsan.c\00", align 1
+@0 = private unnamed_addr constant { i16, i16, [6 x i8] } { i16 0, i16 11, [6 x i8] c"'int'\00" }
+@1 = private unnamed_addr global { { [8 x i8]*, i32, i32 }, { i16, i16, [6 x i8] }* } { { [8 x i8]*, i32, i32 } { [8 x i8]* @.src, i32 7, i32 18 }, { i16, i16, [6 x i8] }* @0 }
+@2 = private unnamed_addr constant { i16, i16, [11 x i8] } { i16 -1, i16 0, [11 x i8] c"'int[100]'\00" }
+@3 = private unnamed_addr global { { [8 x i8]*, i32, i32 }, { i16, i16, [11 x i8] }*, { i16, i16, [6 x i8] }* } { { [8 x i8]*, i32, i32 } { [8 x i8]* @.src, i32 7, i32 9 }, { i16, i16, [11 x i8] }* @2, { i16, i16, [6 x i8] }* @0 }
+@arr = dso_local global [100 x i32] zeroinitializer, align 16
+@4 = private unnamed_addr global { { [8 x i8]*, i32, i32 }, { i16, i16, [6 x i8] }* } { { [8 x i8]*, i32, i32 } { [8 x i8]* @.src, i32 8, i32 13 }, { i16, i16, [6 x i8] }* @0 }
+@5 = private unnamed_addr global { { [8 x i8]*, i32, i32 }, { i16, i16, [6 x i8] }* } { { [8 x i8]*, i32, i32 } { [8 x i8]* @.src, i32 6, i32 34 }, { i16, i16, [6 x i8] }* @0 }
+
+define dso_local i32 @main() #0 {
+entry:
+  br label %for.cond
+
+for.cond:                                         ; preds = %cont5, %entry
+  %sum.0 = phi i32 [ 0, %entry ], [ %7, %cont5 ]
+  %i.0 = phi i32 [ 0, %entry ], [ %13, %cont5 ]
+  %cmp = icmp slt i32 %i.0, 100
+  br i1 %cmp, label %for.body, label %for.end
+
+for.body:                                         ; preds = %for.cond
+  %0 = call { i32, i1 } @llvm.smul.with.overflow.i32(i32 %i.0, i32 3), !nosanitize !2
+  %1 = extractvalue { i32, i1 } %0, 0, !nosanitize !2
+  %2 = extractvalue { i32, i1 } %0, 1, !nosanitize !2
+  %3 = xor i1 %2, true, !nosanitize !2
+  br i1 %3, label %cont, label %handler.mul_overflow, !prof !3, !nosanitize !2
+
+handler.mul_overflow:                             ; preds = %for.body
+  %4 = zext i32 %i.0 to i64, !nosanitize !2
+  call void @__ubsan_handle_mul_overflow(i8* bitcast ({ { [8 x i8]*, i32, i32 }, { i16, i16, [6 x i8] }* }* @1 to i8*), i64 %4, i64 3) #3, !nosanitize !2
+  br label %cont, !nosanitize !2
+
+cont:                                             ; preds = %handler.mul_overflow, %for.body
+  %idxprom = sext i32 %i.0 to i64
+  %5 = icmp ult i64 %idxprom, 100, !nosanitize !2
+  br i1 %5, label %cont1, label %handler.out_of_bounds, !prof !3, !nosanitize !2
+
+handler.out_of_bounds:                            ; preds = %cont
+  call void @__ubsan_handle_out_of_bounds(i8* bitcast ({ { [8 x i8]*, i32, i32 }, { i16, i16, [11 x i8] }*, { i16, i16, [6 x i8] }* }* @3 to i8*), i64 %idxprom) #3, !nosanitize !2
+  br label %cont1, !nosanitize !2
+
+cont1:                                            ; preds = %handler.out_of_bounds, %cont
+  %arrayidx = getelementptr inbounds [100 x i32], [100 x i32]* @arr, i64 0, i64 %idxprom
+  store i32 %1, i32* %arrayidx, align 4
+  %call = call i32 @rand() #3
+  %6 = call { i32, i1 } @llvm.sadd.with.overflow.i32(i32 %sum.0, i32 %call), !nosanitize !2
+  %7 = extractvalue { i32, i1 } %6, 0, !nosanitize !2
+  %8 = extractvalue { i32, i1 } %6, 1, !nosanitize !2
+  %9 = xor i1 %8, true, !nosanitize !2
+  br i1 %9, label %cont3, label %handler.add_overflow, !prof !3, !nosanitize !2
+
+handler.add_overflow:                             ; preds = %cont1
+  %10 = zext i32 %sum.0 to i64, !nosanitize !2
+  %11 = zext i32 %call to i64, !nosanitize !2
+  call void @__ubsan_handle_add_overflow(i8* bitcast ({ { [8 x i8]*, i32, i32 }, { i16, i16, [6 x i8] }* }* @4 to i8*), i64 %10, i64 %11) #3, !nosanitize !2
+  br label %cont3, !nosanitize !2
+
+cont3:                                            ; preds = %handler.add_overflow, %cont1
+  br label %for.inc
+
+for.inc:                                          ; preds = %cont3
+  %12 = call { i32, i1 } @llvm.sadd.with.overflow.i32(i32 %i.0, i32 1), !nosanitize !2
+  %13 = extractvalue { i32, i1 } %12, 0, !nosanitize !2
+  %14 = extractvalue { i32, i1 } %12, 1, !nosanitize !2
+  %15 = xor i1 %14, true, !nosanitize !2
+  br i1 %15, label %cont5, label %handler.add_overflow4, !prof !3, !nosanitize !2
+
+handler.add_overflow4:                            ; preds = %for.inc
+  %16 = zext i32 %i.0 to i64, !nosanitize !2
+  call void @__ubsan_handle_add_overflow(i8* bitcast ({ { [8 x i8]*, i32, i32 }, { i16, i16, [6 x i8] }* }* @5 to i8*), i64 %16, i64 1) #3, !nosanitize !2
+  br label %cont5, !nosanitize !2
+
+cont5:                                            ; preds = %handler.add_overflow4, %for.inc
+  br label %for.cond, !llvm.loop !4
+
+for.end:                                          ; preds = %for.cond
+  ret i32 %sum.0
+}
+
+declare { i32, i1 } @llvm.smul.with.overflow.i32(i32, i32) #1
+declare void @__ubsan_handle_mul_overflow(i8*, i64, i64) #2
+declare void @__ubsan_handle_out_of_bounds(i8*, i64) #2
+declare dso_local i32 @rand() #2
+declare { i32, i1 } @llvm.sadd.with.overflow.i32(i32, i32) #1
+declare void @__ubsan_handle_add_overflow(i8*, i64, i64) #2
+
+attributes #0 = { noinline nounwind uwtable "frame-pointer"="all" }
+attributes #1 = { nofree nosync nounwind readnone speculatable willreturn }
+attributes #2 = { "frame-pointer"="all" }
+attributes #3 = { nounwind }
+
+!llvm.module.flags = !{!0, !1}
+
+!0 = !{i32 1, !"wchar_size", i32 4}
+!1 = !{i32 7, !"uwtable", i32 1}
+!2 = !{}
+!3 = !{!"branch_weights", i32 1048575, i32 1}
+!4 = distinct !{!4, !5}
+!5 = !{!"llvm.loop.mustprogress"}
@@ -0,0 +1,29 @@
+; The arm of the if that is never taken consists of two blocks, so deleting
+; it removes an incoming value of the phi in the join block. The phi has the
+; constant value 7 and must survive until constant folding has replaced it.
+
+define internal i32 @f(i32 %a) {
+entry:
+  %c = icmp eq i32 %a, 0
+  br i1 %c, label %then, label %else
+
+then:
+  br label %then2
+
+then2:
+  br label %join
+
+else:
+  br label %join
+
+join:
+  %x = phi i32 [ 7, %then2 ], [ 7, %else ]
+  %y = add i32 %x, %a
+  ret i32 %y
+}
+
+define i32 @main() {
+entry:
+  %r = call i32 @f(i32 5)
+  ret i32 %r
+}
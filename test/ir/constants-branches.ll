@@ -0,0 +1,62 @@
+; The branch on the constant %c always goes to %then, so %else is dead, the
+; phi and the switch have constant operands, and the loop leaves %k at 3. The
+; returned value folds to 43.
+
+; CHECK-LABEL: define internal i32 @twice(
+; CHECK-NEXT:    ret i32 40
+; CHECK-LABEL: define i32 @main(
+; CHECK:       entry:
+; CHECK-NEXT:    br label %then
+; CHECK-NOT:   else:
+; CHECK:         %t = call i32 @twice(i32 20)
+; CHECK-NOT:     %k = phi
+; CHECK:       exit:
+; CHECK-NEXT:    ret i32 43
+
+@g = global i32 0
+declare i32 @putchar(i32)
+
+define internal i32 @five() {
+  ret i32 5
+}
+
+define internal i32 @twice(i32 %x) {
+  %y = add i32 %x, %x
+  ret i32 %y
+}
+
+define i32 @main() {
+entry:
+  %a = add i32 2, 3
+  %c = icmp eq i32 %a, 5
+  br i1 %c, label %then, label %else
+then:
+  %b = mul i32 %a, 4
+  %p = call i32 @putchar(i32 65)
+  br label %join
+else:
+  %d = sub i32 %a, 1
+  store i32 %d, i32* @g
+  br label %join
+join:
+  %phi = phi i32 [%b, %then], [%d, %else]
+  switch i32 %phi, label %def [i32 20, label %s20
+                               i32 7, label %s7]
+s20:
+  %t = call i32 @twice(i32 %phi)
+  %q = call i32 @putchar(i32 10)
+  br label %loop
+s7:
+  br label %def
+def:
+  ret i32 1
+loop:
+  %i = phi i32 [0, %s20], [%i1, %loop]
+  %k = phi i32 [3, %s20], [%k, %loop]
+  %i1 = add i32 %i, 1
+  %lc = icmp slt i32 %i1, 10
+  br i1 %lc, label %loop, label %exit
+exit:
+  %r = add i32 %t, %k
+  ret i32 %r
+}
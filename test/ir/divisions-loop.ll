@@ -0,0 +1,42 @@
+; %i is in [0, 100) in the loop body: the division by 8 becomes a shift, the
+; signed remainder an unsigned one, urem by 150 and udiv by 200 fold, and urem
+; by 60 becomes a conditional subtraction.
+
+; CHECK-LABEL: body:
+; CHECK-NEXT:    %q = lshr i32 %i, 3
+; CHECK-NEXT:    %r = urem i32 %i, 7
+; CHECK-NEXT:    %[[LOW:[0-9]+]] = icmp ult i32 %i, 60
+; CHECK-NEXT:    %[[HIGH:[0-9]+]] = sub i32 %i, 60
+; CHECK-NEXT:    %twice = select i1 %[[LOW]], i32 %i, i32 %[[HIGH]]
+; CHECK-NOT:     div
+; CHECK:         %a4 = add i32 %a2, %i
+; CHECK:         %a3 = add i32 %a5, 0
+
+declare i32 @printf(i8*, ...)
+@fmt = private constant [4 x i8] c"%d\0A\00"
+
+define i32 @main() {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %body]
+  %acc = phi i32 [1, %entry], [%a3, %body]
+  %cmp = icmp slt i32 %i, 100
+  br i1 %cmp, label %body, label %exit
+body:
+  %q = sdiv i32 %i, 8
+  %r = srem i32 %i, 7
+  %small = urem i32 %i, 150
+  %twice = urem i32 %i, 60
+  %z = udiv i32 %i, 200
+  %a1 = add i32 %acc, %q
+  %a2 = add i32 %a1, %r
+  %a4 = add i32 %a2, %small
+  %a5 = add i32 %a4, %twice
+  %a3 = add i32 %a5, %z
+  %i1 = add i32 %i, 1
+  br label %loop
+exit:
+  %c = call i32 (i8*, ...) @printf(i8* getelementptr ([4 x i8], [4 x i8]* @fmt, i64 0, i64 0), i32 %acc)
+  ret i32 0
+}
@@ -0,0 +1,48 @@
+; %j and %k are affine in the primary induction variable %i, so they are
+; computed from it and their recurrences are deleted.
+
+; CHECK-LABEL: define i32 @g(
+; CHECK:         %i = phi i32 [ 0, %entry ], [ %i1, %latch ]
+; CHECK-NOT:     %j = phi
+; CHECK-NOT:     %k = phi
+; CHECK:         %[[K:[0-9]+]] = mul i32 %i, -1
+; CHECK-NEXT:    %k = add i32 %[[K]], 10
+; CHECK-NEXT:    %[[J:[0-9]+]] = mul i32 %i, 2
+; CHECK-NEXT:    %j = add i32 %[[J]], 3
+; CHECK:       latch:
+; CHECK-NEXT:    %i1 = add nsw i32 %i, 1
+; CHECK-NEXT:    br label %loop
+
+declare i32 @printf(i8*, ...)
+@fmt = private constant [10 x i8] c"%d %d %d\0A\00"
+
+define i32 @g(i32 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i1, %latch ]
+  %j = phi i32 [ 3, %entry ], [ %j1, %latch ]
+  %k = phi i32 [ 10, %entry ], [ %k1, %latch ]
+  %s = phi i32 [ 0, %entry ], [ %s1, %latch ]
+  %c = icmp slt i32 %i, %n
+  br i1 %c, label %body, label %exit
+body:
+  %t = add i32 %s, %j
+  %s1 = add i32 %t, %k
+  br label %latch
+latch:
+  %i1 = add nsw i32 %i, 1
+  %j1 = add i32 %j, 2
+  %k1 = sub i32 %k, 1
+  br label %loop
+exit:
+  ret i32 %s
+}
+
+define i32 @main() {
+  %x = call i32 @g(i32 10)
+  %y = call i32 @g(i32 100)
+  %p = getelementptr [10 x i8], [10 x i8]* @fmt, i32 0, i32 0
+  call i32 (i8*, ...) @printf(i8* %p, i32 %x, i32 %y, i32 0)
+  ret i32 0
+}
@@ -0,0 +1,43 @@
+; %i stays in [0, 100) in the loop body, so its arithmetic gets nsw flags, and
+; nuw flags where it cannot go below 0. The result of @clamp gets !range
+; metadata.
+
+; CHECK-LABEL: define i32 @main(
+; CHECK:         %k = call i32 @clamp(i32 %r), !range ![[RANGE:[0-9]+]]
+; CHECK-NEXT:    %m = mul nuw nsw i32 %i, 4
+; CHECK-NEXT:    %d = sub nsw i32 %i, 1
+; CHECK:         %i1 = add nuw nsw i32 %i, 1
+; CHECK:       ![[RANGE]] = !{i32 0, i32 50}
+
+@arr = global [100 x i32] zeroinitializer
+declare i32 @rand()
+
+define internal i32 @clamp(i32 %x) {
+entry:
+  %c = icmp ult i32 %x, 50
+  br i1 %c, label %small, label %big
+small:
+  ret i32 %x
+big:
+  ret i32 49
+}
+
+define i32 @main() {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %body]
+  %sum = phi i32 [0, %entry], [%s1, %body]
+  %cmp = icmp slt i32 %i, 100
+  br i1 %cmp, label %body, label %exit
+body:
+  %r = call i32 @rand()
+  %k = call i32 @clamp(i32 %r)
+  %m = mul i32 %i, 4
+  %d = sub i32 %i, 1
+  %s1 = add i32 %sum, %i
+  %i1 = add i32 %i, 1
+  br label %loop
+exit:
+  ret i32 %sum
+}
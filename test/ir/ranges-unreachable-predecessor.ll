@@ -0,0 +1,38 @@
+; Blocks after a return or a break, as clang -O0 emits them, are not reachable
+; from the entry, but branch into reachable blocks. They have no node in the
+; fixpoint, count as bottom for the loop head and the return of @clamp, and
+; must not break the narrowing that follows widening.
+
+; CHECK-LABEL: define i32 @main(
+; CHECK:         %k = call i32 @clamp(i32 %i), !range ![[RANGE:[0-9]+]]
+; CHECK:         %i1 = add nuw nsw i32 %i, 1
+; CHECK:       ![[RANGE]] = !{i32 0, i32 8}
+
+define internal i32 @clamp(i32 %x) {
+entry:
+  %c = icmp ult i32 %x, 7
+  br i1 %c, label %small, label %big
+small:
+  ret i32 %x
+big:
+  ret i32 7
+after.return:
+  br label %small
+}
+
+define i32 @main() {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i1, %body ], [ 100, %after.break ]
+  %cmp = icmp slt i32 %i, 10
+  br i1 %cmp, label %body, label %exit
+body:
+  %k = call i32 @clamp(i32 %i)
+  %i1 = add i32 %i, 1
+  br label %loop
+after.break:
+  br label %loop
+exit:
+  ret i32 %i
+}
@@ -0,0 +1,48 @@
+; %a equals %i and %e equals %b, so their uses are replaced. %d is 4 * %i + 4,
+; so the multiplication becomes an addition to the dominating %b = 4 * %i.
+
+; CHECK-LABEL: define i32 @f(
+; CHECK-NOT:     %a =
+; CHECK:         %b = mul i32 %i, 4
+; CHECK:         %d = add i32 %b, 4
+; CHECK-NEXT:    %s1 = add i32 %b, %d
+; CHECK-NEXT:    %s2 = add i32 %s1, %b
+; CHECK-NEXT:    %s3 = add i32 %s2, %i
+
+declare i32 @printf(i8*, ...)
+@fmt = private constant [13 x i8] c"%d %d %d %d\0A\00"
+
+define i32 @f(i32 %n, i32 %i) {
+entry:
+  %a = add i32 %i, 0
+  %b = mul i32 %i, 4
+  %c = add i32 %i, 1
+  %d = mul i32 %c, 4
+  %e = sub i32 %d, 4
+  %s1 = add i32 %b, %d
+  %s2 = add i32 %s1, %e
+  %s3 = add i32 %s2, %a
+  br label %loop
+loop:
+  %j = phi i32 [ 0, %entry ], [ %j1, %loop ]
+  %k = phi i32 [ 5, %entry ], [ %k1, %loop ]
+  %j1 = add i32 %j, 1
+  %k1 = add i32 %k, 1
+  %t = sub i32 %k, %j
+  %m = mul i32 %k1, 3
+  %cmp = icmp slt i32 %j1, %n
+  br i1 %cmp, label %loop, label %exit
+exit:
+  %r = add i32 %s3, %t
+  %r2 = add i32 %r, %m
+  ret i32 %r2
+}
+
+define i32 @main() {
+  %x = call i32 @f(i32 10, i32 7)
+  %y = call i32 @f(i32 3, i32 -2147483647)
+  %z = call i32 @f(i32 1, i32 100)
+  %p = getelementptr [13 x i8], [13 x i8]* @fmt, i32 0, i32 0
+  call i32 (i8*, ...) @printf(i8* %p, i32 %x, i32 %y, i32 %z, i32 0)
+  ret i32 0
+}
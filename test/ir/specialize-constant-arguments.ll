@@ -0,0 +1,49 @@
+; The first three calls pass a constant mode, which decides the switch of @op.
+; They get clones in which the dead cases are deleted, the last call keeps
+; calling @op.
+
+; CHECK-LABEL: define i32 @main(
+; CHECK:         %a = call i32 @[[ADD:op\.specialized[.0-9]*]](i32 0, i32 %x)
+; CHECK-NEXT:    %b = call i32 @[[MUL:op\.specialized[.0-9]*]](i32 1, i32 %a)
+; CHECK-NEXT:    %c = call i32 @[[MUL]](i32 1, i32 %b)
+; CHECK-NEXT:    %d = call i32 @op(i32 %r, i32 %c)
+; CHECK:       define internal i32 @[[MUL]](
+; CHECK-NEXT:  entry:
+; CHECK-NEXT:    br label %mul
+; CHECK:       define internal i32 @[[ADD]](
+; CHECK-NEXT:  entry:
+; CHECK-NEXT:    br label %add
+
+declare i32 @printf(i8*, ...)
+declare i32 @rand()
+@fmt = private constant [4 x i8] c"%d\0A\00"
+
+define internal i32 @op(i32 %mode, i32 %x) {
+entry:
+  switch i32 %mode, label %other [ i32 0, label %add
+                                   i32 1, label %mul ]
+add:
+  %a = add i32 %x, 7
+  br label %done
+mul:
+  %m = mul i32 %x, 3
+  br label %done
+other:
+  %s = sub i32 %x, %mode
+  br label %done
+done:
+  %r = phi i32 [%a, %add], [%m, %mul], [%s, %other]
+  ret i32 %r
+}
+
+define i32 @main() {
+entry:
+  %r = call i32 @rand()
+  %x = urem i32 %r, 5
+  %a = call i32 @op(i32 0, i32 %x)
+  %b = call i32 @op(i32 1, i32 %a)
+  %c = call i32 @op(i32 1, i32 %b)
+  %d = call i32 @op(i32 %r, i32 %c)
+  %t = call i32 (i8*, ...) @printf(i8* getelementptr ([4 x i8], [4 x i8]* @fmt, i64 0, i64 0), i32 %d)
+  ret i32 0
+}
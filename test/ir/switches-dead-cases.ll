@@ -0,0 +1,44 @@
+; %x is in [0, 3), so the case for 7 and the default of the first switch are
+; dead. Only %a and %b reach the join, so the second switch becomes a branch.
+
+; CHECK-LABEL: define i32 @main(
+; CHECK:         switch i32 %x, label %[[DEFAULT:[a-z.]+]] [
+; CHECK-NEXT:      i32 0, label %a
+; CHECK-NEXT:      i32 1, label %b
+; CHECK-NEXT:      i32 2, label %b
+; CHECK-NEXT:    ]
+; CHECK:       [[DEFAULT]]:
+; CHECK-NEXT:    unreachable
+; CHECK:         %v = phi i32 [ 1, %a ], [ %y, %b ]
+; CHECK-NOT:     switch
+
+declare i32 @printf(i8*, ...)
+declare i32 @rand()
+@fmt = private constant [4 x i8] c"%d\0A\00"
+
+define i32 @main() {
+entry:
+  %r = call i32 @rand()
+  %x = urem i32 %r, 3
+  switch i32 %x, label %def [ i32 0, label %a
+                              i32 1, label %b
+                              i32 2, label %b
+                              i32 7, label %c ]
+a:
+  br label %join
+b:
+  %y = add i32 %x, 10
+  br label %join
+c:
+  br label %join
+def:
+  br label %join
+join:
+  %v = phi i32 [1, %a], [%y, %b], [3, %c], [4, %def]
+  %t = call i32 (i8*, ...) @printf(i8* getelementptr ([4 x i8], [4 x i8]* @fmt, i64 0, i64 0), i32 %v)
+  switch i32 %v, label %e1 [ i32 1, label %e2 ]
+e1:
+  ret i32 0
+e2:
+  ret i32 1
+}
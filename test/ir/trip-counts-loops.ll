@@ -0,0 +1,54 @@
+; The header of the loop in @up runs exactly 5 times, which is attached to its
+; !llvm.loop metadata. The loop in @down counts down from a select, and gets no
+; bounds.
+
+; CHECK-LABEL: define i32 @up(
+; CHECK:         br label %for.cond, !llvm.loop ![[LOOP:[0-9]+]]
+; CHECK-LABEL: define i32 @down(
+; CHECK-NOT:     !llvm.loop
+; CHECK:       ![[LOOP]] = distinct !{![[LOOP]], ![[MIN:[0-9]+]], ![[MAX:[0-9]+]]}
+; CHECK-NEXT:  ![[MIN]] = !{!"pain.loop.min_trip_count", i64 5}
+; CHECK-NEXT:  ![[MAX]] = !{!"pain.loop.max_trip_count", i64 5}
+
+declare i32 @printf(i8*, ...)
+@fmt = private constant [7 x i8] c"%d %d\0A\00"
+
+define i32 @up() {
+entry:
+  br label %for.cond
+for.cond:
+  %i = phi i32 [ 0, %entry ], [ %inc, %for.body ]
+  %s = phi i32 [ 0, %entry ], [ %add, %for.body ]
+  %cmp = icmp slt i32 %i, 10
+  br i1 %cmp, label %for.body, label %for.end
+for.body:
+  %add = add nsw i32 %s, %i
+  %inc = add nsw i32 %i, 3
+  br label %for.cond
+for.end:
+  ret i32 %s
+}
+
+define i32 @down(i32 %n) {
+entry:
+  %c0 = icmp sgt i32 %n, 5
+  %start = select i1 %c0, i32 20, i32 12
+  br label %while.body
+while.body:
+  %i = phi i32 [ %start, %entry ], [ %dec, %while.body ]
+  %s = phi i32 [ 0, %entry ], [ %add, %while.body ]
+  %add = add i32 %s, 1
+  %dec = add nsw i32 %i, -2
+  %cmp = icmp sgt i32 %dec, 0
+  br i1 %cmp, label %while.body, label %while.end
+while.end:
+  ret i32 %add
+}
+
+define i32 @main() {
+  %x = call i32 @up()
+  %y = call i32 @down(i32 7)
+  %p = getelementptr [7 x i8], [7 x i8]* @fmt, i32 0, i32 0
+  call i32 (i8*, ...) @printf(i8* %p, i32 %x, i32 %y)
+  ret i32 0
+}
@@ -0,0 +1,36 @@
+; %i fits into 8 bits and %m into 16, so they are computed in i8 and i16 and
+; extended only where an i64 is needed.
+
+; CHECK-LABEL: define i32 @main(
+; CHECK:         %i.narrow = phi i8 [ 0, %entry ], [ %i1.narrow, %body ]
+; CHECK:         %i = zext i8 %i.narrow to i64
+; CHECK:         %[[I16:[0-9]+]] = zext i8 %i.narrow to i16
+; CHECK-NEXT:    %m.narrow = mul i16 %[[I16]], 3
+; CHECK-NEXT:    %m = zext i16 %m.narrow to i64
+; CHECK:         %i1.narrow = add i8 %i.narrow, 1
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+@out = global [100 x i64] zeroinitializer
+declare i32 @printf(i8*, ...)
+@fmt = private constant [5 x i8] c"%ld\0A\00"
+
+define i32 @main() {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [0, %entry], [%i1, %body]
+  %sum = phi i64 [0, %entry], [%s1, %body]
+  %cmp = icmp slt i64 %i, 100
+  br i1 %cmp, label %body, label %exit
+body:
+  %m = mul i64 %i, 3
+  %x = xor i64 %m, 5
+  %p = getelementptr [100 x i64], [100 x i64]* @out, i64 0, i64 %i
+  store i64 %x, i64* %p
+  %s1 = add i64 %sum, %x
+  %i1 = add i64 %i, 1
+  br label %loop
+exit:
+  %c = call i32 (i8*, ...) @printf(i8* getelementptr ([5 x i8], [5 x i8]* @fmt, i64 0, i64 0), i64 %sum)
+  ret i32 0
+}
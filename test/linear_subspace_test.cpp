@@ -14,17 +14,15 @@ class LinearSubspaceTest: LinearSubspace {
 public:
     static bool runTestLeastUpperBound1();
     static bool runTestLeastUpperBound2();
+    static bool runTestMergeOperations();
+    static bool runTestProjectOut();
 };
 
 const llvm::Value *x1 = (llvm::Value *) 1;
 const llvm::Value *x2 = (llvm::Value *) 2;
 const llvm::Value *x3 = (llvm::Value *) 3;
 
-const std::unordered_map<llvm::Value const *, int> mock_index = {
-    {x1, 1},
-    {x2, 2},
-    {x3, 3},
-};
+const DimensionEnvironment::Ptr mock_env = DimensionEnvironment::make({x1, x2, x3});
 
 bool LinearSubspaceTest::runTestLeastUpperBound1() {
     std::cout << "Testing least upper bound 1: ";
@@ -33,12 +31,12 @@ bool LinearSubspaceTest::runTestLeastUpperBound1() {
     LinearSubspace r1 = LinearSubspace();
     r1.isBottom = false;
     r1.basis = {MatrixType(4)};
-    r1.index = mock_index;
+    r1.env = mock_env;
 
     LinearSubspace r2 = LinearSubspace();
     r2.isBottom = false;
     r2.basis = {MatrixType(4)};
-    r2.index = mock_index;
+    r2.env = mock_env;
 
     LinearSubspace expected = LinearSubspace();
     expected.basis = {MatrixType(4)};
@@ -62,14 +60,14 @@ bool LinearSubspaceTest::runTestLeastUpperBound2() {
     b1.setValue(0,1, 1);
     b1.setValue(2,1, 1);
     r1.basis = {b1};
-    r1.index = mock_index;
+    r1.env = mock_env;
 
     LinearSubspace r2 = LinearSubspace();
     r2.isBottom = false;
     MatrixType b2 = MatrixType(4);
     b2.setValue(0,3, 1);
     r2.basis = {b2};
-    r2.index = mock_index;
+    r2.env = mock_env;
 
     LinearSubspace expected = LinearSubspace();
     MatrixType e1 =  MatrixType(4);
@@ -93,10 +91,77 @@ bool LinearSubspaceTest::runTestLeastUpperBound2() {
     return result;
 }
 
+bool LinearSubspaceTest::runTestMergeOperations() {
+    std::cout << "Testing merge operations: ";
+    bool result = false;
+
+    LinearSubspace r1 = LinearSubspace();
+    r1.isBottom = false;
+    MatrixType b1 = MatrixType(4);
+    b1.setValue(0,1, 1);
+    b1.setValue(2,1, 1);
+    r1.basis = {b1};
+    r1.env = mock_env;
+
+    LinearSubspace r2 = LinearSubspace();
+    r2.isBottom = false;
+    MatrixType b2 = MatrixType(4);
+    b2.setValue(0,3, 1);
+    r2.basis = {b2};
+    r2.env = mock_env;
+
+    LinearSubspace joined = r1;
+    joined.merge(Merge_op::UPPER_BOUND, r2);
+
+    LinearSubspace widened = r1;
+    bool widen_changed = widened.merge(Merge_op::WIDEN, r2);
+    // The state is stable now
+    bool widen_stable = !widened.merge(Merge_op::WIDEN, r2) && !widened.merge(Merge_op::UPPER_BOUND, joined);
+
+    LinearSubspace narrowed = joined;
+    bool narrow_changed = narrowed.merge(Merge_op::NARROW, r1);
+
+    result = widen_changed && widen_stable && widened.basis == joined.basis
+        && !narrow_changed && narrowed.basis == joined.basis;
+
+    std::cout << (result? "success" : "failed") << "\n";
+    return result;
+}
+
+bool LinearSubspaceTest::runTestProjectOut() {
+    std::cout << "Testing project out: ";
+    bool result = false;
+
+    // x2 = x1 + 1, x3 = 2 * x2
+    LinearSubspace r1 = LinearSubspace();
+    r1.isBottom = false;
+    r1.basis = {MatrixType(4)};
+    r1.env = mock_env;
+    r1.affineAssignment(x2, 1, x1, 1);
+    r1.affineAssignment(x3, 2, x2, 0);
+
+    // x3 depends on the value of x1 on entry, so x1 has to stay
+    r1.projectOut([](llvm::Value const* value) { return value == x1 || value == x2; });
+
+    LinearSubspace expected = LinearSubspace();
+    expected.isBottom = false;
+    expected.basis = {MatrixType(3)};
+    expected.env = DimensionEnvironment::make({x1, x3});
+    expected.affineAssignment(x3, 2, x1, 2);
+    MatrixType normalized = MatrixType::span(MatrixType(vector<vector<T>>{expected.basis[0].toVector()}), true);
+    expected.basis = normalized.reshapeColumns(3, 3);
+
+    result = *r1.env == *expected.env && r1.basis == expected.basis;
+
+    std::cout << (result? "success" : "failed") << "\n";
+    return result;
+}
 
 int main() {
     return !(LinearSubspaceTest::runTestLeastUpperBound1()
              && LinearSubspaceTest::runTestLeastUpperBound2()
+             && LinearSubspaceTest::runTestMergeOperations()
+             && LinearSubspaceTest::runTestProjectOut()
     );
 };
 
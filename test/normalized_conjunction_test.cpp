@@ -3,6 +3,7 @@
 #include <iostream>
 #include <string>
 #include <dlfcn.h>
+#include <set>
 
 #include "../src/normalized_conjunction.h"
 #include "../src/linear_equality.h"
@@ -16,6 +17,7 @@ class NormalizedConjunctionTest: NormalizedConjunction {
 public:
     static bool runTestAll();
     static bool runTestMerge();
+    static bool runTestMergeOperations();
     static bool runTestX0();
     static bool runTestX1();
     static bool runTestX2();
@@ -24,6 +26,7 @@ public:
     static bool runNonDeterministicAssignmentTest2();
     static bool runLinearAssignmentTest1();
     static bool runLinearAssignmentTest2();
+    static bool runProjectTest();
 };
 
 const Value *x1 = (Value *) 1;
@@ -69,7 +72,19 @@ const std::unordered_map<Value const *, LinearEquality> E2 = {
     {x12, {x12, 4, x1, -5}}
 };
 
-auto mapToSeccond = [](std::pair<Value const*, LinearEquality> p){ return p.second; };
+/// Non-trivial equalities of the join of E1 and E2, restricted to `variables`
+std::unordered_map<Value const*, LinearEquality> joinedEqualities(std::set<Value const*> const& variables) {
+    auto joined = NormalizedConjunction(E1);
+    joined.leastUpperBound(NormalizedConjunction(E2));
+
+    std::unordered_map<Value const*, LinearEquality> result;
+    for (auto [key, eq]: joined.equalities()) {
+        if (variables.count(key) > 0) {
+            result[key] = eq;
+        }
+    }
+    return result;
+}
 
 
 bool NormalizedConjunctionTest::runTestAll() {
@@ -86,7 +101,7 @@ bool NormalizedConjunctionTest::runTestAll() {
     auto actual = NormalizedConjunction(E1);
     actual.leastUpperBound(NormalizedConjunction(E2));
     
-    result = actual.values == expected;
+    result = actual.equalities() == expected;
     
     std::cout << (result? "success" : "failed") << "\n";
     return result;
@@ -119,7 +134,30 @@ bool NormalizedConjunctionTest::runTestMerge() {
     auto other = NormalizedConjunction(y);
     actual.merge(Merge_op::UPPER_BOUND, other);
 
-    result = actual.values == x;
+    result = actual == NormalizedConjunction(x);
+
+    std::cout << (result? "success" : "failed") << "\n";
+    return result;
+}
+
+bool NormalizedConjunctionTest::runTestMergeOperations() {
+    std::cout << "Testing merge operations: ";
+    bool result = false;
+
+    auto joined = NormalizedConjunction(E1);
+    joined.merge(Merge_op::UPPER_BOUND, NormalizedConjunction(E2));
+
+    auto widened = NormalizedConjunction(E1);
+    bool widen_changed = widened.merge(Merge_op::WIDEN, NormalizedConjunction(E2));
+    // The state is stable now
+    bool widen_stable = !widened.merge(Merge_op::WIDEN, NormalizedConjunction(E2))
+        && !widened.merge(Merge_op::UPPER_BOUND, joined);
+
+    auto narrowed = joined;
+    bool narrow_changed = narrowed.merge(Merge_op::NARROW, NormalizedConjunction(E1));
+
+    result = widen_changed && widen_stable && widened == joined
+        && !narrow_changed && narrowed == joined;
 
     std::cout << (result? "success" : "failed") << "\n";
     return result;
@@ -129,15 +167,11 @@ bool NormalizedConjunctionTest::runTestX0() {
     std::cout << "Testing X0: ";
     bool result = true;
     
-    std::set<LinearEquality> expected = {
-        {x4, 3, x2, 5}
+    std::unordered_map<Value const*, LinearEquality> expected = {
+        {x4, {x4, 3, x2, 5}}
     };
     
-    std::set<LinearEquality> E1Set, E2Set;
-    transform(E1, std::inserter(E1Set, E1Set.end()), mapToSeccond);
-    transform(E2, std::inserter(E2Set, E2Set.end()), mapToSeccond);
-    
-    auto actual = NormalizedConjunction::computeX0(E1Set, E2Set);
+    auto actual = joinedEqualities({x1, x2, x4});
     
     result = actual == expected;
     std::cout << (result ? "success" : "failed") << "\n";
@@ -148,15 +182,11 @@ bool NormalizedConjunctionTest::runTestX1() {
     std::cout << "Testing X1: ";
     bool result = false;
     
-    std::set<LinearEquality> expected = {
-        {x10, 2, x9, 2}
+    std::unordered_map<Value const*, LinearEquality> expected = {
+        {x10, {x10, 2, x9, 2}}
     };
     
-    std::set<LinearEquality> E1Set, E2Set;
-    transform(E1, std::inserter(E1Set, E1Set.end()), mapToSeccond);
-    transform(E2, std::inserter(E2Set, E2Set.end()), mapToSeccond);
-    
-    auto actual = NormalizedConjunction::computeX1(E1Set, E2Set);
+    auto actual = joinedEqualities({x9, x10});
     
     result = actual == expected;
     std::cout << (result ? "success" : "failed") << "\n";
@@ -167,15 +197,11 @@ bool NormalizedConjunctionTest::runTestX2() {
     std::cout << "Testing X2: ";
     bool result = false;
     
-    std::set<LinearEquality> expected = {
-        {x12, 2, x11, 1}
+    std::unordered_map<Value const*, LinearEquality> expected = {
+        {x12, {x12, 2, x11, 1}}
     };
     
-    std::set<LinearEquality> E1Set, E2Set;
-    transform(E1, std::inserter(E1Set, E1Set.end()), mapToSeccond);
-    transform(E2, std::inserter(E2Set, E2Set.end()), mapToSeccond);
-    
-    auto actual = NormalizedConjunctionTest::computeX2(E1Set, E2Set);
+    auto actual = joinedEqualities({x11, x12});
     
     result = actual == expected;
     std::cout << (result? "success" : "failed") << "\n";
@@ -186,16 +212,12 @@ bool NormalizedConjunctionTest::runTestX4() {
     std::cout << "Testing X4: ";
     bool result = false;
     
-    std::set<LinearEquality> expected = {
-        {x5, 3, x3, 15},
-        {x7, 1, x6, -1}
+    std::unordered_map<Value const*, LinearEquality> expected = {
+        {x5, {x5, 3, x3, 15}},
+        {x7, {x7, 1, x6, -1}}
     };
     
-    std::set<LinearEquality> E1Set, E2Set;
-    transform(E1, std::inserter(E1Set, E1Set.end()), mapToSeccond);
-    transform(E2, std::inserter(E2Set, E2Set.end()), mapToSeccond);
-    
-    auto actual = NormalizedConjunctionTest::computeX4(E1Set, E2Set);
+    auto actual = joinedEqualities({x3, x5, x6, x7, x8});
     
     result = actual == expected;
     std::cout << (result? "success" : "failed") << "\n";
@@ -218,7 +240,7 @@ bool NormalizedConjunctionTest::runNonDeterministicAssignmentTest1() {
     
     E.nonDeterminsticAssignment(x2);
     
-    result = E.values == expected.values;
+    result = E == expected;
     std::cout << (result? "success" : "failed") << "\n";
     return result;
 }
@@ -243,7 +265,7 @@ bool NormalizedConjunctionTest::runNonDeterministicAssignmentTest2() {
     
     E.nonDeterminsticAssignment(x1);
     
-    result = E.values == expected.values;
+    result = E == expected;
     std::cout << (result? "success" : "failed") << "\n";
     return result;
 }
@@ -267,7 +289,7 @@ bool NormalizedConjunctionTest::runLinearAssignmentTest1() {
     
     E.linearAssignment(x2, 1, x1, 3);
     
-    result = E.values == expected.values;
+    result = E == expected;
     std::cout << (result? "success" : "failed") << "\n";
     return result;
 }
@@ -296,7 +318,32 @@ bool NormalizedConjunctionTest::runLinearAssignmentTest2() {
     
     E.linearAssignment(x2, 1, x4, 1);
     
-    result = E.values == expected.values;
+    result = E == expected;
+    std::cout << (result? "success" : "failed") << "\n";
+    return result;
+}
+
+bool NormalizedConjunctionTest::runProjectTest() {
+    std::cout << "Testing project: ";
+    bool result = false;
+    
+    NormalizedConjunction E = NormalizedConjunction({
+        {x1, {x1, 1, x1, 0}},
+        {x2, {x2, 1, x1, 2}},
+        {x3, {x3, 1, x1, 6}},
+        {x4, {x4, 1, x1, 10}},
+        {x5, {x5, 1, nullptr, 7}}
+    });
+    
+    auto expected = NormalizedConjunction({
+        {x2, {x2, 1, x2, 0}},
+        {x3, {x3, 1, x2, 4}},
+        {x4, {x4, 1, x2, 8}}
+    });
+    
+    E.project([](Value const* value) { return value != x1 && value != x5; });
+    
+    result = E == expected;
     std::cout << (result? "success" : "failed") << "\n";
     return result;
 }
@@ -309,9 +356,11 @@ int main() {
              && NormalizedConjunctionTest::runTestX4()
              && NormalizedConjunctionTest::runTestAll()
              && NormalizedConjunctionTest::runTestMerge()
+             && NormalizedConjunctionTest::runTestMergeOperations()
              && NormalizedConjunctionTest::runNonDeterministicAssignmentTest1()
              && NormalizedConjunctionTest::runNonDeterministicAssignmentTest2()
              && NormalizedConjunctionTest::runLinearAssignmentTest1()
              && NormalizedConjunctionTest::runLinearAssignmentTest2()
+             && NormalizedConjunctionTest::runProjectTest()
         );
 }
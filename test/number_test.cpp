@@ -0,0 +1,195 @@
+#include <cstdio>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "../src/number.h"
+
+using namespace pcpo;
+using namespace llvm;
+
+class NumberTest {
+
+public:
+    static bool runTestSmall();
+    static bool runTestOverflow();
+    static bool runTestMinimum();
+    static bool runTestFraction();
+    static bool runTestCompare();
+    static bool runTestAPInt();
+    static bool runTestShared();
+    static bool runTestRandom();
+};
+
+const int64_t max = std::numeric_limits<int64_t>::max();
+const int64_t min = std::numeric_limits<int64_t>::min();
+
+/// Value of a number with at most 128 bits
+__int128 wide(Number const& number) {
+    APInt value = number.numerator().sextOrTrunc(128);
+    return (__int128(value.getHiBits(64).getZExtValue()) << 64) | value.getLoBits(64).getZExtValue();
+}
+
+bool NumberTest::runTestSmall() {
+    std::cout << "Testing small: ";
+    Number a = 6;
+    Number b = -4;
+
+    bool result = (a + b).isSmall() && a + b == 2
+        && a - b == 10
+        && a * b == -24
+        && (a * b / b).isSmall() && a * b / b == a
+        && -a == -6;
+
+    std::cout << (result? "success" : "failed") << "\n";
+    return result;
+}
+
+bool NumberTest::runTestOverflow() {
+    std::cout << "Testing overflow: ";
+    Number a = max;
+
+    Number sum = a + 1;
+    Number product = a * a;
+
+    bool result = !sum.isSmall() && sum.isInteger()
+        && sum > a
+        && (sum - 1).isSmall() && sum - 1 == a
+        && !product.isSmall() && wide(product) == __int128(max) * max
+        && product / a == a && (product / a).isSmall()
+        && Number {min} - 1 < min;
+
+    std::cout << (result? "success" : "failed") << "\n";
+    return result;
+}
+
+bool NumberTest::runTestMinimum() {
+    std::cout << "Testing minimum: ";
+    Number a = min;
+
+    Number negated = -a;
+    Number quotient = a / -1;
+
+    bool result = !negated.isSmall() && wide(negated) == -__int128(min)
+        && negated == quotient
+        && -negated == a && (-negated).isSmall()
+        && (a / 2).isSmall() && a / 2 == min / 2;
+
+    std::cout << (result? "success" : "failed") << "\n";
+    return result;
+}
+
+bool NumberTest::runTestFraction() {
+    std::cout << "Testing fraction: ";
+    Number third = Number {1} / 3;
+    Number half = Number {-3} / -6;
+
+    bool result = !third.isInteger()
+        && third + third + third == 1 && (third + third + third).isSmall()
+        && Number {6} / 4 == Number {3} / 2
+        && hash_value(Number {6} / 4) == hash_value(Number {3} / 2)
+        && half == Number {1} / 2 && half.sign() == 1
+        && (-half).sign() == -1 && (-half).denominator() == 2
+        && third * 3 == 1
+        && half / third == Number {3} / 2;
+
+    std::cout << (result? "success" : "failed") << "\n";
+    return result;
+}
+
+bool NumberTest::runTestCompare() {
+    std::cout << "Testing compare: ";
+    Number third = Number {1} / 3;
+    Number big = Number {max} + max;
+
+    bool result = third < 1 && third > 0 && -third < 0
+        && Number {1} / 4 < third
+        && big > max && -big < min
+        && third != Number {1} / 4
+        && big != Number {max}
+        && third <= third && third >= third;
+
+    std::cout << (result? "success" : "failed") << "\n";
+    return result;
+}
+
+bool NumberTest::runTestAPInt() {
+    std::cout << "Testing APInt: ";
+    APInt wide_value = APInt::getSignedMaxValue(128);
+
+    bool result = Number {APInt {8, 200}} == -56
+        && Number {APInt {32, 7}}.isSmall()
+        && !Number {wide_value}.isSmall()
+        && Number {wide_value}.numerator() == wide_value
+        && Number {wide_value} - Number {wide_value} == 0;
+
+    std::cout << (result? "success" : "failed") << "\n";
+    return result;
+}
+
+bool NumberTest::runTestShared() {
+    std::cout << "Testing shared: ";
+    Number copy;
+    std::vector<Number> numbers;
+    {
+        Number big = Number {max} + max;
+        copy = big;
+        numbers.assign(3, big);
+        numbers.push_back(Number {max} + max);
+    }
+    Number moved = std::move(numbers.back());
+    numbers.pop_back();
+    numbers[1] = numbers[0];
+    numbers[2] = 1;
+
+    bool result = !copy.isSmall() && wide(copy) == __int128(max) * 2
+        && numbers[0] == copy && numbers[1] == copy && numbers[2] == 1
+        && moved == copy && moved - copy == 0;
+
+    std::cout << (result? "success" : "failed") << "\n";
+    return result;
+}
+
+bool NumberTest::runTestRandom() {
+    std::cout << "Testing random: ";
+    bool result = true;
+
+    uint64_t state = 0xd1620b2a7a243d4bull;
+    auto rand64 = [&state]() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545f4914f6cdd1dull;
+    };
+
+    for (int i = 0; i < 100000 && result; i++) {
+        // Mix small and large values, so that both paths are taken
+        int64_t x = int64_t(rand64()) >> (rand64() % 64);
+        int64_t y = int64_t(rand64()) >> (rand64() % 64);
+        Number a = x;
+        Number b = y;
+
+        result = wide(a + b) == __int128(x) + y
+            && wide(a - b) == __int128(x) - y
+            && wide(a * b) == __int128(x) * y
+            && (a < b) == (x < y)
+            && (y == 0 || (a / b) * b == a)
+            && (y == 0 || (a / b).isInteger() == (__int128(x) % y == 0));
+    }
+
+    std::cout << (result? "success" : "failed") << "\n";
+    return result;
+}
+
+int main() {
+    return !(NumberTest::runTestSmall()
+             && NumberTest::runTestOverflow()
+             && NumberTest::runTestMinimum()
+             && NumberTest::runTestFraction()
+             && NumberTest::runTestCompare()
+             && NumberTest::runTestAPInt()
+             && NumberTest::runTestShared()
+             && NumberTest::runTestRandom()
+        );
+}
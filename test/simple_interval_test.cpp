@@ -46,6 +46,7 @@ void testSimpleDomain(u32 w, u32 iters, u64* errs) {
     SimpleInterval add0, add1, add2, sub0, sub1;
     SimpleInterval sub2, mul0, mul1, mul2, udiv;
     SimpleInterval urem, srem, lub, glb;
+    SimpleInterval zext, sext, trunc;
     SimpleInterval aeq, ane, aslt, asle, asge;
     SimpleInterval asgt, ault, aule, auge, augt;
     SimpleInterval beq, bne, bslt, bsle, bsge;
@@ -123,6 +124,9 @@ void testSimpleDomain(u32 w, u32 iters, u64* errs) {
         srem = a_._SRem(b_)             ._makeTopSpecial();
         lub  = a_._upperBound(b_)       ._makeTopSpecial();
         glb  = a_._narrow(b_)           ._makeTopSpecial();
+        zext = a_._Cast(llvm::Instruction::ZExt, 2*w)       ._makeTopSpecial();
+        sext = a_._Cast(llvm::Instruction::SExt, 2*w)       ._makeTopSpecial();
+        trunc= a_._Cast(llvm::Instruction::Trunc, w/2)      ._makeTopSpecial();
         aeq  = SimpleInterval::_refineBranch(llvm::CmpInst::Predicate::ICMP_EQ,  a_, b_)._makeTopSpecial();
         ane  = SimpleInterval::_refineBranch(llvm::CmpInst::Predicate::ICMP_NE,  a_, b_)._makeTopSpecial();
         aslt = SimpleInterval::_refineBranch(llvm::CmpInst::Predicate::ICMP_SLT, a_, b_)._makeTopSpecial();
@@ -195,6 +199,8 @@ void testSimpleDomain(u32 w, u32 iters, u64* errs) {
             *errs += !y.isNullValue() && !urem.contains(x.urem(y));
             *errs += !y.isNullValue() && !srem.contains(x.srem(y));
             *errs += !lub.contains(x) || !lub.contains(y);
+            *errs += !zext.contains(x.zext(2*w)) || !sext.contains(x.sext(2*w));
+            *errs += !trunc.contains(x.trunc(w/2));
             *errs += b.contains(x) && !glb.contains(x);
             *errs += a.contains(y) && !glb.contains(y);
             *errs += !a.contains(y) && glb.contains(y);